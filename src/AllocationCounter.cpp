@@ -0,0 +1,107 @@
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(DEM_COUNT_ALLOCATIONS)
+#define DEM_ALLOCATION_COUNTER 1
+
+//one slot per thread, written only by its thread; threads past the table share the last slot
+struct ThreadAllocations {
+	std::atomic<qint64> count{ 0 };
+	std::atomic<bool> ignored{ false };
+};
+static const int maxThreads = 256;
+static ThreadAllocations threadSlots[maxThreads];
+static std::atomic<int> slotsUsed{ 0 };
+
+static ThreadAllocations& threadSlot()
+{
+	thread_local ThreadAllocations* slot = &threadSlots[std::min(slotsUsed.fetch_add(1, std::memory_order_relaxed), maxThreads - 1)];
+	return *slot;
+}
+
+static inline void countAllocation()
+{
+	ThreadAllocations& slot = threadSlot();
+	slot.count.store(slot.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+
+//shared debug CRT: malloc of the Qt debug DLLs and operator new end up here
+static int allocHook(int type, void*, size_t, int, long, const unsigned char*, int)
+{
+	if (type == _HOOK_ALLOC || type == _HOOK_REALLOC)
+		countAllocation();
+	return TRUE;
+}
+
+static const bool hookInstalled = (_CrtSetAllocHook(allocHook), true);
+#else
+//operator new only, the C allocator stays as it is
+void* operator new(size_t size)
+{
+	countAllocation();
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	countAllocation();
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+#endif
+#endif
+
+bool AllocationCounter::available()
+{
+#ifdef DEM_ALLOCATION_COUNTER
+	return true;
+#else
+	return false;
+#endif
+}
+
+qint64 AllocationCounter::count()
+{
+#ifdef DEM_ALLOCATION_COUNTER
+	qint64 total = 0;
+	int used = std::min(slotsUsed.load(std::memory_order_relaxed), maxThreads);
+	for (int i = 0; i < used; ++i) {
+		if (!threadSlots[i].ignored.load(std::memory_order_relaxed))
+			total += threadSlots[i].count.load(std::memory_order_relaxed);
+	}
+	return total;
+#else
+	return -1;
+#endif
+}
+
+void AllocationCounter::ignoreThisThread()
+{
+#ifdef DEM_ALLOCATION_COUNTER
+	threadSlot().ignored.store(true, std::memory_order_relaxed);
+#endif
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <QtGlobal>
+
+//Debug count of heap allocations, per thread: replaced operator new, or the alloc hook of the MSVC debug CRT
+//(that one also sees malloc, so Qt containers; operator new alone misses them)
+//off unless built with DEM_COUNT_ALLOCATIONS (CMake option), count() is -1 then
+class AllocationCounter {
+public:
+	static bool available();
+	//allocations of all threads except the ignored ones
+	static qint64 count();
+	//the calling thread no longer counts, for the GUI thread that allocates while frames render
+	static void ignoreThisThread();
+};
@@ -0,0 +1,85 @@
+#include "BatchRenderer.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+
+//DemBatch input.dat [-o dir] (--views list.txt | --turntable N [--tilt deg]) [--size WxH] [--ramp name] [--mode name]
+int main(int argc, char* argv[])
+{
+	QLocale::setDefault(QLocale::c());
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("DemBatch");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Renders views of a DEM to PNG files without a display");
+	parser.addHelpOption();
+	parser.addPositionalArgument("input", "DEM file (XYZ .dat)");
+
+	QCommandLineOption outOption(QStringList() << "o" << "output", "Output directory.", "dir", ".");
+	QCommandLineOption viewsOption("views", "View list, one 'name rotX rotY rotZ [zoom] [zScale]' per line.", "file");
+	QCommandLineOption turntableOption("turntable", "Frames around the Z axis.", "frames");
+	QCommandLineOption tiltOption("tilt", "X rotation of the turntable frames in degrees.", "degrees", "0");
+	QCommandLineOption sizeOption("size", "Image size.", "WxH", "1024x1024");
+	QCommandLineOption rampOption("ramp", "Color ramp: terrain, grayscale, bathymetric, viridis.", "name", "terrain");
+	QCommandLineOption modeOption("mode", "Render mode: filled, wireframe, raycast, hillshade, slope, aspect.", "name", "filled");
+	parser.addOption(outOption);
+	parser.addOption(viewsOption);
+	parser.addOption(turntableOption);
+	parser.addOption(tiltOption);
+	parser.addOption(sizeOption);
+	parser.addOption(rampOption);
+	parser.addOption(modeOption);
+	parser.process(app);
+
+	QStringList inputs = parser.positionalArguments();
+	if (inputs.size() != 1 || parser.isSet("views") == parser.isSet("turntable"))
+		parser.showHelp(1);
+
+	QStringList size = parser.value("size").split('x');
+	int width = size.size() == 2 ? size[0].toInt() : 0;
+	int height = size.size() == 2 ? size[1].toInt() : 0;
+	if (width <= 0 || height <= 0) {
+		qWarning() << "Bad --size" << parser.value("size");
+		return 1;
+	}
+
+	int ramp = 0;
+	while (ramp < int(ColorRamp::Count) && QString(ColorLut::rampName(ColorRamp(ramp))).toLower() != parser.value("ramp").toLower())
+		ramp++;
+	if (ramp == int(ColorRamp::Count)) {
+		qWarning() << "Unknown --ramp" << parser.value("ramp");
+		return 1;
+	}
+
+	int mode = 0;
+	while (mode < ModeCount && QString(Renderer::renderModeName(mode)).toLower() != parser.value("mode").toLower())
+		mode++;
+	if (mode == ModeCount) {
+		qWarning() << "Unknown --mode" << parser.value("mode");
+		return 1;
+	}
+
+	QVector<BatchView> views;
+	if (parser.isSet("views")) {
+		if (!BatchRenderer::readViews(parser.value("views"), views))
+			return 1;
+	}
+	else {
+		views = BatchRenderer::turntable(parser.value("turntable").toInt(), parser.value("tilt").toFloat());
+	}
+	if (views.isEmpty()) {
+		qWarning() << "No views to render";
+		return 1;
+	}
+
+	BatchRenderer batch;
+	if (!batch.load(inputs[0]))
+		return 1;
+	batch.setImageSize(QSize(width, height));
+	batch.setColorRamp(ColorRamp(ramp));
+	batch.setRenderMode(mode);
+
+	int written = batch.renderAll(views, parser.value("output"));
+	return written == views.size() ? 0 : 1;
+}
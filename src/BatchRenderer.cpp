@@ -0,0 +1,115 @@
+#include "BatchRenderer.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+bool BatchRenderer::load(const QString& path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		qWarning() << "Cannot open" << path;
+		return false;
+	}
+	return master.load(file);
+}
+
+bool BatchRenderer::readViews(const QString& path, QVector<BatchView>& out)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		qWarning() << "Cannot open" << path;
+		return false;
+	}
+
+	int lineNumber = 0;
+	while (!file.atEnd()) {
+		QString line = QString::fromUtf8(file.readLine()).simplified();
+		lineNumber++;
+		if (line.isEmpty() || line.startsWith("#")) continue;
+
+		QStringList parts = line.split(' ');
+		bool ok = parts.size() >= 4 && parts.size() <= 6;
+		BatchView view;
+		view.name = parts[0];
+		float values[5] = { 0, 0, 0, 1.0f, 1.0f };
+		for (int i = 1; ok && i < parts.size(); ++i)
+			values[i - 1] = parts[i].toFloat(&ok);
+		if (!ok) {
+			qWarning() << path << "line" << lineNumber << "expected: name rotX rotY rotZ [zoom] [zScale]";
+			return false;
+		}
+		view.rotation = QVector3D(values[0], values[1], values[2]);
+		view.zoom = values[3];
+		view.zScale = values[4];
+		out.append(view);
+	}
+	return true;
+}
+
+QVector<BatchView> BatchRenderer::turntable(int frames, float tiltX)
+{
+	QVector<BatchView> views;
+	for (int i = 0; i < frames; ++i) {
+		BatchView view;
+		view.name = QString("frame_%1").arg(i, 4, 10, QChar('0'));
+		view.rotation = QVector3D(tiltX, 0, 360.0f * i / frames);
+		views.append(view);
+	}
+	return views;
+}
+
+int BatchRenderer::renderAll(const QVector<BatchView>& views, const QString& outDir)
+{
+	if (!QDir().mkpath(outDir)) {
+		qWarning() << "Cannot create" << outDir;
+		return 0;
+	}
+	QDir dir(outDir);
+
+	QElapsedTimer timer;
+	timer.start();
+	int written = 0;
+
+#ifdef _OPENMP
+	//one frame per thread, the loops inside Renderer run serially instead of oversubscribing
+	//max active levels is OpenMP 3.0, MSVC /openmp is 2.0
+#if _OPENMP >= 200805
+	omp_set_max_active_levels(1);
+#else
+	omp_set_nested(0);
+#endif
+#endif
+
+	#pragma omp parallel reduction(+:written)
+	{
+		//per thread caches and image, shared heights / normals / LOD tree
+		Renderer renderer;
+		renderer.shareModel(master);
+		QImage image(imageSize, QImage::Format_ARGB32);
+
+		#pragma omp for schedule(dynamic)
+		for (int i = 0; i < views.size(); ++i) {
+			const BatchView& view = views[i];
+			renderer.setModelRotation(view.rotation);
+			renderer.setZoom(view.zoom);
+			renderer.setZScaleFactor(view.zScale);
+			//an unchanged view leaves the previous, identical frame in image
+			renderer.render(image);
+
+			QString path = dir.filePath(view.name + ".png");
+			if (image.save(path, "PNG"))
+				written++;
+			else
+				qWarning() << "Cannot write" << path;
+		}
+	}
+
+	double seconds = timer.elapsed() / 1000.0;
+	qDebug() << "Batch:" << written << "/" << views.size() << "frames in" << seconds << "s"
+		<< (seconds > 0 ? written / seconds : 0) << "frames/s";
+	return written;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include <QVector3D>
+#include <QSize>
+#include "Renderer.h"
+
+//one output frame
+struct BatchView {
+	QString name;           //output file name, without .png
+	QVector3D rotation;     //model rotation X, Y, Z in degrees
+	float zoom = 1.0f;
+	float zScale = 1.0f;
+};
+
+//Headless rendering of many views of one DEM into PNG files
+//the DEM is parsed once, every worker thread renders whole frames with its own Renderer sharing it
+class BatchRenderer {
+public:
+	bool load(const QString& path);
+
+	//"name rotX rotY rotZ [zoom] [zScale]" per line, # starts a comment
+	static bool readViews(const QString& path, QVector<BatchView>& out);
+	//frames evenly around the Z axis, tilted by tiltX
+	static QVector<BatchView> turntable(int frames, float tiltX);
+
+	void setImageSize(QSize size) { imageSize = size; }
+	void setColorRamp(ColorRamp ramp) { master.setColorRamp(int(ramp)); }
+	void setRenderMode(int mode) { master.setRenderMode(mode); }
+
+	//frames rendered concurrently across the cores, returns the number of files written
+	int renderAll(const QVector<BatchView>& views, const QString& outDir);
+
+private:
+	Renderer master;        //owns the parsed model, never renders
+	QSize imageSize = QSize(1024, 1024);
+};
@@ -0,0 +1,267 @@
+#include "Renderer.h"
+#include "XyzParser.h"
+#include "VertexTransform.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+
+//Stage benchmarks: one CSV row per stage on stdout, logs on stderr
+//DemBench [--min-time ms] [--max-size N] [--max-parse N] [files...]
+//without files the bundled .dat grids are used, then synthetic grids 256 .. max-size per side
+
+#ifndef DEM_DATA_DIR
+#define DEM_DATA_DIR "src"
+#endif
+
+struct BenchResult {
+	int iterations;
+	double minMs, medianMs, meanMs;
+};
+
+//repeats fn for at least minTimeMs and 3 runs
+static BenchResult measure(const std::function<void()>& fn, double minTimeMs)
+{
+	const int minIterations = 3, maxIterations = 1000;
+	std::vector<double> times;
+	double total = 0;
+	while (int(times.size()) < minIterations || (total < minTimeMs && int(times.size()) < maxIterations)) {
+		QElapsedTimer timer;
+		timer.start();
+		fn();
+		double ms = timer.nsecsElapsed() / 1e6;
+		times.push_back(ms);
+		total += ms;
+	}
+	std::sort(times.begin(), times.end());
+	return { int(times.size()), times.front(), times[times.size() / 2], total / times.size() };
+}
+
+static void report(const QString& dataset, qint64 items, const char* stage, const BenchResult& result)
+{
+	std::printf("%s,%lld,%s,%d,%.4f,%.4f,%.4f\n", qPrintable(dataset), (long long)items, stage,
+		result.iterations, result.minMs, result.medianMs, result.meanMs);
+	std::fflush(stdout);
+}
+
+//XYZ text of a grid, for timing the parser on synthetic data
+static bool writeXyz(const QString& path, Model& model)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly)) return false;
+	char line[96];
+	for (qint64 i = 0; i < model.getGrid().vertexCount(); ++i) {
+		QVector3D p = model.vertex(i);
+		int n = std::snprintf(line, sizeof(line), "%.6f %.6f %.6f\n", p.x(), p.y(), p.z());
+		file.write(line, n);
+	}
+	return true;
+}
+
+static void benchParse(const QString& name, const QString& path, QVector<Point>& points, double minTime)
+{
+	report(name, QFileInfo(path).size(), "parse", measure([&] {
+		QFile file(path);
+		file.open(QIODevice::ReadOnly | QIODevice::Text);
+		points.clear();
+		XyzParser::parse(file, points);
+	}, minTime));
+}
+
+//heap allocations of the last measured frame, -1 in builds without DEM_COUNT_ALLOCATIONS
+static void logFrameMemory(const QString& dataset, const char* stage, Renderer& renderer)
+{
+	FrameProfile frame = renderer.getProfiler().lastFrame();
+	qDebug().noquote() << dataset << stage << "allocations" << frame.allocations << "arena" << frame.arenaBytes / 1024 << "KB";
+}
+
+//model already in renderer: grid stages, then whole frames
+static void benchGrid(const QString& name, Renderer& renderer, double minTime)
+{
+	Model& model = renderer.getModel();
+	const GridInfo& grid = model.getGrid();
+	const float* heights = model.getHeights();
+	qint64 n = grid.vertexCount();
+	qDebug() << "Benchmark" << name << grid.cols << "x" << grid.rows;
+
+	//setupModel() = z range + a log line
+	report(name, n, "setup_model", measure([&] { model.computeZRange(); }, minTime));
+	report(name, n, "normals", measure([&] { model.computeNormals(); }, minTime));
+	TerrainLod lod;
+	report(name, n, "lod_build", measure([&] { lod.build(grid, heights); }, minTime));
+	RayCaster rayCaster;
+	report(name, n, "max_mipmap", measure([&] { rayCaster.build(grid, heights); }, minTime));
+
+	QMatrix4x4 frame = renderer.getCamera().viewMatrix() * model.modelMatrix();
+	ProjectedGrid projected;
+	report(name, n, "transform", measure([&] { VertexTransform::transformGrid(frame, grid, heights, projected); }, minTime));
+	//default fit only flips y, repeated runs stay finite
+	ViewFit fit;
+	report(name, n, "to_screen", measure([&] { VertexTransform::toScreen(projected, fit); }, minTime));
+
+	std::vector<QRgb> colors(n);
+	report(name, n, "shading", measure([&] {
+		#pragma omp parallel for schedule(static)
+		for (int r = 0; r < grid.rows; ++r) {
+			qint64 row = qint64(r) * grid.cols;
+			for (int c = 0; c < grid.cols; ++c)
+				colors[row + c] = renderer.shadeVertex(row + c, heights[row + c]);
+		}
+	}, minTime));
+
+	//whole frames: geometry + colors + raster, then raster only
+	QImage image(1024, 1024, QImage::Format_ARGB32);
+	renderer.render(image);
+	report(name, n, "frame_lod", measure([&] { renderer.invalidate(StageGeometry | StageColors); renderer.render(image); }, minTime));
+	logFrameMemory(name, "frame_lod", renderer);
+	report(name, n, "frame_lod_cached", measure([&] { renderer.invalidate(StageFrame); renderer.render(image); }, minTime));
+	logFrameMemory(name, "frame_lod_cached", renderer);
+	float tolerance = renderer.getLodTolerance();
+	renderer.setLodTolerance(0);
+	report(name, n, "frame_full", measure([&] { renderer.invalidate(StageGeometry | StageColors); renderer.render(image); }, minTime));
+	logFrameMemory(name, "frame_full", renderer);
+	report(name, n, "frame_full_cached", measure([&] { renderer.invalidate(StageFrame); renderer.render(image); }, minTime));
+	logFrameMemory(name, "frame_full_cached", renderer);
+	renderer.setLodTolerance(tolerance);
+
+	renderer.setRenderMode(ModeRaycast);
+	report(name, n, "frame_raycast", measure([&] { renderer.invalidate(StageFrame); renderer.render(image); }, minTime));
+	logFrameMemory(name, "frame_raycast", renderer);
+	renderer.setRenderMode(ModeFilled);
+}
+
+//fill and line primitives on deterministic small shapes, independent of the DEM
+static void benchPrimitives(double minTime)
+{
+	const int size = 1024, count = 100000;
+	QImage image(size, size, QImage::Format_ARGB32);
+	image.fill(Qt::white);
+
+	//~8 px quads kept inside the image, the scanline edge table is indexed by y
+	quint32 seed = 12345;
+	auto next = [&seed] { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / float(1 << 24); };
+	std::vector<QPointF> points(size_t(count) * 4);
+	for (int i = 0; i < count; ++i) {
+		QPointF center(16 + next() * (size - 32), 16 + next() * (size - 32));
+		for (int k = 0; k < 4; ++k)
+			points[size_t(i) * 4 + k] = center + QPointF((next() - 0.5f) * 16, (next() - 0.5f) * 16);
+	}
+	const QRgb color = qRgb(90, 140, 60);
+
+	FrameArena arena;
+	report("primitives", count, "scanline_fill", measure([&] {
+		for (int i = 0; i < count; ++i)
+			Renderer::fillPolygonScanLine(image, points.data() + size_t(i) * 4, 4, color, arena);
+	}, minTime));
+
+	report("primitives", count, "draw_line", measure([&] {
+		for (int i = 0; i < count; ++i)
+			Renderer::drawLine(image, points[size_t(i) * 4].toPoint(), points[size_t(i) * 4 + 2].toPoint(), color);
+	}, minTime));
+
+	Rasterizer rasterizer;
+	rasterizer.setTarget(&image);
+	auto fillAll = [&] {
+		rasterizer.beginFrame();
+		for (int i = 0; i < count; ++i) {
+			const QPointF* p = points.data() + size_t(i) * 4;
+			float depth = float(i % 97);
+			rasterizer.fillTriangle(QVector3D(p[0].x(), p[0].y(), depth), QVector3D(p[1].x(), p[1].y(), depth),
+				QVector3D(p[2].x(), p[2].y(), depth), color);
+		}
+		rasterizer.flush();
+	};
+	report("primitives", count, "triangle_fill", measure(fillAll, minTime));
+	rasterizer.setSimd(false);
+	report("primitives", count, "triangle_fill_scalar", measure(fillAll, minTime));
+	rasterizer.setSimd(true);
+	rasterizer.setBinned(false);
+	report("primitives", count, "triangle_fill_serial", measure(fillAll, minTime));
+}
+
+int main(int argc, char* argv[])
+{
+	QLocale::setDefault(QLocale::c());
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("DemBench");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Times every render pipeline stage, CSV on stdout");
+	parser.addHelpOption();
+	parser.addPositionalArgument("files", "XYZ .dat files, default: the bundled grids");
+	QCommandLineOption minTimeOption("min-time", "Minimum time per stage in ms.", "ms", "200");
+	QCommandLineOption maxSizeOption("max-size", "Largest synthetic grid side, 0 = none.", "N", "8192");
+	QCommandLineOption maxParseOption("max-parse", "Largest synthetic grid side written and parsed as XYZ.", "N", "2048");
+	parser.addOption(minTimeOption);
+	parser.addOption(maxSizeOption);
+	parser.addOption(maxParseOption);
+	parser.process(app);
+
+	double minTime = parser.value("min-time").toDouble();
+	int maxSize = parser.value("max-size").toInt();
+	int maxParse = parser.value("max-parse").toInt();
+
+	QStringList files = parser.positionalArguments();
+	if (files.isEmpty())
+		files << QString(DEM_DATA_DIR) + "/SK_101x101.dat" << QString(DEM_DATA_DIR) + "/Himalaje_201x201.dat";
+
+	std::printf("dataset,items,stage,iterations,min_ms,median_ms,mean_ms\n");
+	benchPrimitives(minTime);
+
+	for (const QString& path : files) {
+		QString name = QFileInfo(path).completeBaseName();
+		QVector<Point> points;
+		benchParse(name, path, points, minTime);
+
+		Renderer renderer;
+		report(name, points.size(), "build_grid", measure([&] { renderer.getModel().buildGrid(points); }, minTime));
+		if (!renderer.prepareModel()) {
+			qWarning() << "Skipped" << path;
+			continue;
+		}
+		benchGrid(name, renderer, minTime);
+	}
+
+	for (int side = 256; side <= maxSize; side *= 2) {
+		QString name = QString("synthetic_%1").arg(side);
+		Renderer renderer;
+		renderer.getModel().generateTestGrid(side, side, 30.0);
+
+		if (side <= maxParse) {
+			QString path = QDir(QDir::tempPath()).filePath(name + ".dat");
+			if (writeXyz(path, renderer.getModel())) {
+				QVector<Point> points;
+				benchParse(name, path, points, minTime);
+				Model model;
+				report(name, points.size(), "build_grid", measure([&] { model.buildGrid(points); }, minTime));
+				//streamed load path: parse and grid check straight into the .demc
+				QString cachePath = DemCache::cachePath(path);
+				QVector<Point> unused;
+				report(name, points.size(), "parse_to_cache", measure([&] {
+					QFile file(path);
+					file.open(QIODevice::ReadOnly);
+					XyzParser::parseToCache(file, cachePath, file.size(), unused);
+				}, minTime));
+				QFile::remove(cachePath);
+
+				//same heights off the nodes: every point moved by up to 0.4 spacing, deterministic
+				for (int i = 0; i < points.size(); ++i) {
+					points[i].x += 12.0 * std::sin(i * 12.9898);
+					points[i].y += 12.0 * std::sin(i * 78.233);
+				}
+				report(name, points.size(), "build_scattered", measure([&] { model.buildScattered(points); }, minTime));
+				QFile::remove(path);
+			}
+		}
+
+		renderer.prepareModel();
+		benchGrid(name, renderer, minTime);
+	}
+	return 0;
+}
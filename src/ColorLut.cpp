@@ -0,0 +1,81 @@
+#include "ColorLut.h"
+#include <iterator>
+
+//blue, green, yellow, red: the original viewer ramp
+static constexpr RampStop terrainStops[] = {
+	{ 0.0f, 0, 0, 128 },
+	{ 0.3f, 0, 255, 0 },
+	{ 0.6f, 255, 255, 0 },
+	{ 1.0f, 255, 0, 0 },
+};
+
+static constexpr RampStop grayscaleStops[] = {
+	{ 0.0f, 0, 0, 0 },
+	{ 1.0f, 255, 255, 255 },
+};
+
+//deep water to shallows
+static constexpr RampStop bathymetricStops[] = {
+	{ 0.0f, 8, 29, 88 },
+	{ 0.25f, 37, 52, 148 },
+	{ 0.5f, 34, 94, 168 },
+	{ 0.75f, 65, 182, 196 },
+	{ 1.0f, 199, 233, 180 },
+};
+
+//viridis sampled every 1/8, perceptually uniform
+static constexpr RampStop viridisStops[] = {
+	{ 0.0f, 68, 1, 84 },
+	{ 0.125f, 71, 44, 122 },
+	{ 0.25f, 59, 81, 139 },
+	{ 0.375f, 44, 113, 142 },
+	{ 0.5f, 33, 144, 141 },
+	{ 0.625f, 39, 173, 129 },
+	{ 0.75f, 92, 200, 99 },
+	{ 0.875f, 170, 220, 50 },
+	{ 1.0f, 253, 231, 37 },
+};
+
+void ColorLut::setRamp(ColorRamp value)
+{
+	if (value == ramp) return;
+	ramp = value;
+
+	switch (ramp) {
+	case ColorRamp::Grayscale: bake(grayscaleStops, int(std::size(grayscaleStops))); break;
+	case ColorRamp::Bathymetric: bake(bathymetricStops, int(std::size(bathymetricStops))); break;
+	case ColorRamp::Viridis: bake(viridisStops, int(std::size(viridisStops))); break;
+	default:
+		ramp = ColorRamp::Terrain;
+		bake(terrainStops, int(std::size(terrainStops)));
+		break;
+	}
+}
+
+void ColorLut::bake(const RampStop* stops, int count)
+{
+	//stops sorted by x, linear between neighbours, clamped past the ends
+	int segment = 0;
+	for (int i = 0; i < size; ++i) {
+		float x = float(i) / (size - 1);
+		while (segment + 2 < count && x > stops[segment + 1].x)
+			segment++;
+
+		const RampStop& a = stops[segment];
+		const RampStop& b = stops[count > 1 ? segment + 1 : segment];
+		float t = b.x > a.x ? (x - a.x) / (b.x - a.x) : 0.0f;
+		t = t < 0 ? 0 : (t > 1 ? 1 : t);
+		table[i] = qRgb(int(a.r + t * (b.r - a.r)), int(a.g + t * (b.g - a.g)), int(a.b + t * (b.b - a.b)));
+	}
+}
+
+const char* ColorLut::rampName(ColorRamp ramp)
+{
+	switch (ramp) {
+	case ColorRamp::Terrain: return "Terrain";
+	case ColorRamp::Grayscale: return "Grayscale";
+	case ColorRamp::Bathymetric: return "Bathymetric";
+	case ColorRamp::Viridis: return "Viridis";
+	default: return "";
+	}
+}
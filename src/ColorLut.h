@@ -0,0 +1,38 @@
+#pragma once
+#include <QRgb>
+#include <array>
+
+//control point of a color ramp, x in [0, 1]
+struct RampStop {
+	float x;
+	quint8 r, g, b;
+};
+
+enum class ColorRamp { Terrain, Grayscale, Bathymetric, Viridis, Count };
+
+//Color ramp baked into a packed ARGB table, one indexed load per lookup
+//the table is rebuilt only when the ramp changes
+class ColorLut {
+public:
+	static const int size = 4096;
+
+	ColorLut() { setRamp(ColorRamp::Terrain); }
+
+	void setRamp(ColorRamp ramp);
+	ColorRamp getRamp() const { return ramp; }
+	void bake(const RampStop* stops, int count);
+
+	//t = normalized height, clamped to [0, 1]
+	QRgb lookup(float t) const {
+		if (!(t > 0)) return table[0];
+		if (t >= 1) return table[size - 1];
+		return table[int(t * (size - 1) + 0.5f)];
+	}
+	const QRgb* data() const { return table.data(); }
+
+	static const char* rampName(ColorRamp ramp);
+
+private:
+	std::array<QRgb, size> table;
+	ColorRamp ramp = ColorRamp::Count;
+};
@@ -0,0 +1,388 @@
+#include "Delaunay.h"
+#include "Model.h"
+#include <QDebug>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//edge storage of one strip, a merged strip is appended to its left neighbour
+struct Delaunay::Mesh {
+	std::vector<int> onext, oprev, org;     //org = -1: deleted
+	std::vector<int> freeEdges;
+
+	int dest(int e) const { return org[e ^ 1]; }
+	int lnext(int e) const { return oprev[e ^ 1]; }
+	int rprev(int e) const { return onext[e ^ 1]; }
+
+	int makeEdge(int a, int b) {
+		int e;
+		if (!freeEdges.empty()) {
+			e = freeEdges.back();
+			freeEdges.pop_back();
+		}
+		else {
+			e = int(org.size());
+			onext.resize(e + 2);
+			oprev.resize(e + 2);
+			org.resize(e + 2);
+		}
+		org[e] = a;
+		org[e ^ 1] = b;
+		onext[e] = oprev[e] = e;
+		onext[e ^ 1] = oprev[e ^ 1] = e ^ 1;
+		return e;
+	}
+
+	//swaps the onext of a and b, joins or splits their origin rings; oprev is the inverse ring
+	void splice(int a, int b) {
+		int alpha = onext[a], beta = onext[b];
+		onext[a] = beta;
+		onext[b] = alpha;
+		oprev[beta] = a;
+		oprev[alpha] = b;
+	}
+
+	//new edge from dest(a) to org(b), left faces of a, the new edge and b shared
+	int connect(int a, int b) {
+		int e = makeEdge(dest(a), org[b]);
+		splice(e, lnext(a));
+		splice(e ^ 1, b);
+		return e;
+	}
+
+	void deleteEdge(int e) {
+		splice(e, oprev[e]);
+		splice(e ^ 1, oprev[e ^ 1]);
+		org[e] = org[e ^ 1] = -1;
+		freeEdges.push_back(e & ~1);
+	}
+
+	//returns the index offset of other's edges
+	int append(const Mesh& other) {
+		int offset = int(org.size());
+		for (size_t i = 0; i < other.org.size(); ++i) {
+			onext.push_back(other.onext[i] + offset);
+			oprev.push_back(other.oprev[i] + offset);
+			org.push_back(other.org[i]);
+		}
+		for (int e : other.freeEdges)
+			freeEdges.push_back(e + offset);
+		return offset;
+	}
+};
+
+//chunks sorted concurrently, then merged pairwise level by level
+template<class Less>
+static void parallelSort(std::vector<int>& items, Less less)
+{
+	int chunks = 1;
+#ifdef _OPENMP
+	while (chunks * 2 <= omp_get_max_threads() && items.size() / (chunks * 2) >= 4096)
+		chunks *= 2;
+#endif
+	qint64 n = qint64(items.size());
+	auto bound = [&](int i) { return items.begin() + n * i / chunks; };
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < chunks; ++i)
+		std::sort(bound(i), bound(i + 1), less);
+	for (int step = 1; step < chunks; step *= 2) {
+		#pragma omp parallel for schedule(static)
+		for (int i = 0; i < chunks; i += 2 * step)
+			std::inplace_merge(bound(i), bound(i + step), bound(i + 2 * step), less);
+	}
+}
+
+void Delaunay::clear()
+{
+	xs.clear();
+	ys.clear();
+	zs.clear();
+	onext.clear();
+	oprev.clear();
+	org.clear();
+	outer.clear();
+	vertexEdge.clear();
+	triangles = 0;
+	hash.clear();
+}
+
+bool Delaunay::ccw(int a, int b, int c) const
+{
+	return (xs[b] - xs[a]) * (ys[c] - ys[a]) - (ys[b] - ys[a]) * (xs[c] - xs[a]) > 0;
+}
+
+//d strictly inside the circle through a, b, c (counter-clockwise)
+bool Delaunay::inCircle(int a, int b, int c, int d) const
+{
+	double adx = xs[a] - xs[d], ady = ys[a] - ys[d];
+	double bdx = xs[b] - xs[d], bdy = ys[b] - ys[d];
+	double cdx = xs[c] - xs[d], cdy = ys[c] - ys[d];
+	double det = (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy)
+		+ (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy)
+		+ (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+	return det > 0;
+}
+
+Delaunay::HullEdges Delaunay::triangulate(Mesh& mesh, int begin, int end) const
+{
+	int n = end - begin;
+	if (n == 2) {
+		int a = mesh.makeEdge(begin, begin + 1);
+		return { a, a ^ 1 };
+	}
+	if (n == 3) {
+		int s1 = begin, s2 = begin + 1, s3 = begin + 2;
+		int a = mesh.makeEdge(s1, s2);
+		int b = mesh.makeEdge(s2, s3);
+		mesh.splice(a ^ 1, b);
+		if (ccw(s1, s2, s3)) {
+			mesh.connect(b, a);
+			return { a, b ^ 1 };
+		}
+		if (ccw(s1, s3, s2)) {
+			int c = mesh.connect(b, a);
+			return { c ^ 1, c };
+		}
+		//collinear, no triangle yet
+		return { a, b ^ 1 };
+	}
+
+	int mid = begin + n / 2;
+	HullEdges left = triangulate(mesh, begin, mid);
+	HullEdges right = triangulate(mesh, mid, end);
+	return merge(mesh, left, right);
+}
+
+Delaunay::HullEdges Delaunay::merge(Mesh& mesh, HullEdges left, HullEdges right) const
+{
+	int ldo = left.left, ldi = left.right;
+	int rdi = right.left, rdo = right.right;
+	auto rightOf = [&](int p, int e) { return ccw(p, mesh.dest(e), mesh.org[e]); };
+	auto leftOf = [&](int p, int e) { return ccw(p, mesh.org[e], mesh.dest(e)); };
+
+	//lower common tangent of the two hulls
+	for (;;) {
+		if (leftOf(mesh.org[rdi], ldi))
+			ldi = mesh.lnext(ldi);
+		else if (rightOf(mesh.org[ldi], rdi))
+			rdi = mesh.rprev(rdi);
+		else
+			break;
+	}
+
+	int basel = mesh.connect(rdi ^ 1, ldi);
+	if (mesh.org[ldi] == mesh.org[ldo]) ldo = basel ^ 1;
+	if (mesh.org[rdi] == mesh.org[rdo]) rdo = basel;
+
+	//zip upwards: each step adds the cross edge to the candidate whose circle is empty
+	auto valid = [&](int e) { return rightOf(mesh.dest(e), basel); };
+	for (;;) {
+		int lcand = mesh.onext[basel ^ 1];
+		if (valid(lcand)) {
+			while (inCircle(mesh.dest(basel), mesh.org[basel], mesh.dest(lcand), mesh.dest(mesh.onext[lcand]))) {
+				int next = mesh.onext[lcand];
+				mesh.deleteEdge(lcand);
+				lcand = next;
+			}
+		}
+		int rcand = mesh.oprev[basel];
+		if (valid(rcand)) {
+			while (inCircle(mesh.dest(basel), mesh.org[basel], mesh.dest(rcand), mesh.dest(mesh.oprev[rcand]))) {
+				int next = mesh.oprev[rcand];
+				mesh.deleteEdge(rcand);
+				rcand = next;
+			}
+		}
+
+		bool leftValid = valid(lcand), rightValid = valid(rcand);
+		if (!leftValid && !rightValid) break;
+		if (!leftValid || (rightValid && inCircle(mesh.dest(lcand), mesh.org[lcand], mesh.org[rcand], mesh.dest(rcand))))
+			basel = mesh.connect(rcand, basel ^ 1);
+		else
+			basel = mesh.connect(basel ^ 1, lcand ^ 1);
+	}
+	return { ldo, rdo };
+}
+
+bool Delaunay::build(const QVector<Point>& points)
+{
+	clear();
+	int n = points.size();
+	if (n < 3) return false;
+
+	//lexicographic order, ties by input index so the first duplicate wins
+	std::vector<int> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	parallelSort(order, [&points](int a, int b) {
+		const Point& p = points[a];
+		const Point& q = points[b];
+		if (p.x != q.x) return p.x < q.x;
+		if (p.y != q.y) return p.y < q.y;
+		return a < b;
+	});
+
+	//relative coordinates keep the predicates precise on projected (UTM) inputs
+	originX = points[order[0]].x;
+	originY = points[order[0]].y;
+	xs.reserve(n);
+	ys.reserve(n);
+	zs.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		const Point& p = points[order[i]];
+		if (i > 0 && p.x == points[order[i - 1]].x && p.y == points[order[i - 1]].y) continue;
+		xs.push_back(p.x - originX);
+		ys.push_back(p.y - originY);
+		zs.push_back(float(p.z));
+	}
+	std::vector<int>().swap(order);
+	int count = vertexCount();
+	if (count < 3) {
+		qWarning() << "Delaunay: fewer than 3 distinct points";
+		return false;
+	}
+	boundsMin[0] = xs.front();
+	boundsMax[0] = xs.back();
+	boundsMin[1] = *std::min_element(ys.begin(), ys.end());
+	boundsMax[1] = *std::max_element(ys.begin(), ys.end());
+
+	//one strip per thread (a power of two), each big enough to be worth it
+	int strips = 1;
+#ifdef _OPENMP
+	while (strips * 2 <= omp_get_max_threads() && count / (strips * 2) >= 1024)
+		strips *= 2;
+#endif
+	std::vector<Mesh> meshes(strips);
+	std::vector<HullEdges> hulls(strips);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < strips; ++s) {
+		int begin = int(qint64(count) * s / strips);
+		int end = int(qint64(count) * (s + 1) / strips);
+		//~3 edges per point in the result
+		meshes[s].org.reserve(size_t(end - begin) * 6);
+		meshes[s].onext.reserve(size_t(end - begin) * 6);
+		meshes[s].oprev.reserve(size_t(end - begin) * 6);
+		hulls[s] = triangulate(meshes[s], begin, end);
+	}
+
+	//neighbouring strips merged pairwise, the merges of one level are independent
+	for (int step = 1; step < strips; step *= 2) {
+		#pragma omp parallel for schedule(dynamic)
+		for (int s = 0; s < strips; s += 2 * step) {
+			int offset = meshes[s].append(meshes[s + step]);
+			meshes[s + step] = Mesh();
+			HullEdges right = { hulls[s + step].left + offset, hulls[s + step].right + offset };
+			hulls[s] = merge(meshes[s], hulls[s], right);
+		}
+	}
+
+	onext.swap(meshes[0].onext);
+	oprev.swap(meshes[0].oprev);
+	org.swap(meshes[0].org);
+	meshes.clear();
+
+	//outer face: right of the ccw hull edge out of the leftmost point
+	outer.assign(org.size(), 0);
+	int hull = hulls[0].left ^ 1;
+	int e = hull;
+	qint64 outerEdges = 0;
+	do {
+		outer[e] = 1;
+		outerEdges++;
+		e = oprev[e ^ 1];
+	} while (e != hull);
+
+	qint64 liveEdges = 0;
+	vertexEdge.assign(count, -1);
+	for (int i = 0; i < int(org.size()); ++i) {
+		if (org[i] < 0) continue;
+		liveEdges++;
+		vertexEdge[org[i]] = i;
+	}
+	//every inner face is a triangle
+	triangles = (liveEdges - outerEdges) / 3;
+	if (triangles == 0) {
+		qWarning() << "Delaunay: all points are collinear";
+		clear();
+		return false;
+	}
+
+	hash.build(xs.data(), ys.data(), count);
+	return true;
+}
+
+int Delaunay::locate(double x, double y, int e, bool& outside) const
+{
+	//(x, y) right of edge
+	auto rightOf = [&](int edge) {
+		int a = org[edge], b = org[edge ^ 1];
+		return (xs[b] - xs[a]) * (y - ys[a]) - (ys[b] - ys[a]) * (x - xs[a]) < 0;
+	};
+
+	//visibility walk: cross any edge the point is right of, ends on Delaunay meshes
+	//after a step e is the edge just crossed, not tested again: a point on it may test right of both sides
+	outside = false;
+	if (outer[e]) e ^= 1;
+	for (qint64 step = 0; step <= triangles; ++step) {
+		int e1 = oprev[e ^ 1];
+		int e2 = oprev[e1 ^ 1];
+		int next;
+		if (step == 0 && rightOf(e))
+			next = e ^ 1;
+		else if (rightOf(e1))
+			next = e1 ^ 1;
+		else if (rightOf(e2))
+			next = e2 ^ 1;
+		else
+			return e;
+		//about to cross a hull edge: outside, that edge is returned
+		if (outer[next]) {
+			outside = true;
+			return next ^ 1;
+		}
+		e = next;
+	}
+	return -1;
+}
+
+float Delaunay::heightAt(double x, double y, int& hint) const
+{
+	if (xs.empty()) return 0;
+	x -= originX;
+	y -= originY;
+
+	if (hint < 0 || hint >= int(org.size()) || org[hint] < 0)
+		hint = vertexEdge[hash.nearest(x, y)];
+	bool outside;
+	int e = locate(x, y, hint, outside);
+	if (e < 0) {
+		int v = hash.nearest(x, y);
+		hint = vertexEdge[v];
+		return zs[v];
+	}
+	hint = e;
+
+	//outside: along the hull edge, continuous with the inside
+	if (outside) {
+		int a = org[e], b = org[e ^ 1];
+		double dx = xs[b] - xs[a], dy = ys[b] - ys[a];
+		double t = std::clamp(((x - xs[a]) * dx + (y - ys[a]) * dy) / (dx * dx + dy * dy), 0.0, 1.0);
+		return float(zs[a] + t * (zs[b] - zs[a]));
+	}
+
+	//barycentric weights in the triangle left of e
+	int a = org[e], b = org[e ^ 1], c = org[oprev[e ^ 1] ^ 1];
+	auto area = [&](int p, int q, double px, double py) {
+		return (xs[q] - xs[p]) * (py - ys[p]) - (ys[q] - ys[p]) * (px - xs[p]);
+	};
+	double total = area(a, b, xs[c], ys[c]);
+	if (total <= 0) return zs[a];
+	double wa = area(b, c, x, y) / total;
+	double wb = area(c, a, x, y) / total;
+	return float(wa * zs[a] + wb * zs[b] + (1 - wa - wb) * zs[c]);
+}
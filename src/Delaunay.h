@@ -0,0 +1,52 @@
+#pragma once
+#include <QVector>
+#include <vector>
+#include "SpatialHash.h"
+
+struct Point;
+
+//Delaunay triangulation of scattered (x, y) points, Guibas-Stolfi divide and conquer
+//the sorted points are split into one strip per thread, strips are triangulated concurrently
+//and merged pairwise, the merges of one level also run in parallel
+//edges are quad-edges without the dual: directed edge e, its twin e ^ 1, onext / oprev rings per origin
+class Delaunay {
+public:
+	//duplicate (x, y) keep the first z; false = fewer than 3 distinct points or all collinear
+	bool build(const QVector<Point>& points);
+	void clear();
+
+	int vertexCount() const { return int(xs.size()); }
+	qint64 triangleCount() const { return triangles; }
+	double minX() const { return originX + boundsMin[0]; }
+	double minY() const { return originY + boundsMin[1]; }
+	double maxX() const { return originX + boundsMax[0]; }
+	double maxY() const { return originY + boundsMax[1]; }
+
+	//linear interpolation in the containing triangle, outside the hull along the nearest crossed hull edge
+	//hint = edge to start walking from, keep it between nearby queries (-1 = find one by the spatial hash)
+	float heightAt(double x, double y, int& hint) const;
+
+private:
+	struct Mesh;
+	struct HullEdges { int left, right; };   //ccw hull edge out of the leftmost point, cw out of the rightmost
+
+	HullEdges triangulate(Mesh& mesh, int begin, int end) const;
+	HullEdges merge(Mesh& mesh, HullEdges left, HullEdges right) const;
+	bool ccw(int a, int b, int c) const;
+	bool inCircle(int a, int b, int c, int d) const;
+	//edge with the containing triangle on its left, or the hull edge the point is outside of; -1 = lost
+	int locate(double x, double y, int start, bool& outside) const;
+
+	//coordinates relative to origin, sorted by x then y
+	double originX = 0, originY = 0;
+	double boundsMin[2] = { 0, 0 }, boundsMax[2] = { 0, 0 };
+	std::vector<double> xs, ys;
+	std::vector<float> zs;
+
+	//final mesh: onext / oprev per directed edge, origin vertex, outer = outer face on the left
+	std::vector<int> onext, oprev, org;
+	std::vector<char> outer;
+	std::vector<int> vertexEdge;
+	qint64 triangles = 0;
+	SpatialHash hash;
+};
@@ -0,0 +1,110 @@
+#include "DemCache.h"
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+
+static const char cacheMagic[4] = { 'D', 'E', 'M', 'C' };
+static const quint32 cacheVersion = 1;
+
+bool DemCache::isFresh(const QString& cachePath, const QString& sourcePath)
+{
+	QFileInfo cacheInfo(cachePath);
+	QFileInfo sourceInfo(sourcePath);
+	if (!cacheInfo.exists() || !sourceInfo.exists())
+		return false;
+	return cacheInfo.lastModified() >= sourceInfo.lastModified();
+}
+
+bool DemCache::writeHeader(QIODevice& out, const GridInfo& grid, qint64 sourceSize)
+{
+	DemCacheHeader header;
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.rows = grid.rows;
+	header.cols = grid.cols;
+	header.originX = grid.originX;
+	header.originY = grid.originY;
+	header.spacingX = grid.spacingX;
+	header.spacingY = grid.spacingY;
+	header.minZ = grid.minZ;
+	header.maxZ = grid.maxZ;
+	header.sourceSize = quint64(sourceSize);
+	return out.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header));
+}
+
+bool DemCache::write(const QString& path, const GridInfo& grid, const float* heights, qint64 sourceSize)
+{
+	if (!grid.isValid() || heights == nullptr)
+		return false;
+
+	//QSaveFile -> a half written cache is never left behind
+	QSaveFile out(path);
+	if (!out.open(QIODevice::WriteOnly)) {
+		qWarning() << "Cannot write cache" << path;
+		return false;
+	}
+
+	qint64 dataBytes = grid.vertexCount() * qint64(sizeof(float));
+	if (!writeHeader(out, grid, sourceSize) ||
+		out.write(reinterpret_cast<const char*>(heights), dataBytes) != dataBytes) {
+		qWarning() << "Cannot write cache" << path;
+		out.cancelWriting();
+		return false;
+	}
+	return out.commit();
+}
+
+bool DemCache::open(const QString& path, qint64 sourceSize)
+{
+	close();
+
+	file.setFileName(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	if (file.size() < qint64(sizeof(DemCacheHeader))) {
+		close();
+		return false;
+	}
+
+	mapped = file.map(0, file.size());
+	if (mapped == nullptr) {
+		close();
+		return false;
+	}
+
+	const DemCacheHeader* header = reinterpret_cast<const DemCacheHeader*>(mapped);
+	bool valid = std::memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0
+		&& header->version == cacheVersion
+		&& header->sourceSize == quint64(sourceSize)
+		&& header->rows > 1 && header->cols > 1
+		&& file.size() == qint64(sizeof(DemCacheHeader)) + qint64(header->rows) * header->cols * qint64(sizeof(float));
+	if (!valid) {
+		qDebug() << "Stale cache" << path;
+		close();
+		return false;
+	}
+
+	grid.originX = header->originX;
+	grid.originY = header->originY;
+	grid.spacingX = header->spacingX;
+	grid.spacingY = header->spacingY;
+	grid.rows = header->rows;
+	grid.cols = header->cols;
+	grid.minZ = header->minZ;
+	grid.maxZ = header->maxZ;
+	heights = reinterpret_cast<const float*>(mapped + sizeof(DemCacheHeader));
+	return true;
+}
+
+void DemCache::close()
+{
+	if (mapped != nullptr)
+		file.unmap(mapped);
+	if (file.isOpen())
+		file.close();
+	mapped = nullptr;
+	heights = nullptr;
+	grid = GridInfo();
+}
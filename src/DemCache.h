@@ -0,0 +1,44 @@
+#pragma once
+#include <QFile>
+#include <QString>
+#include "Grid.h"
+
+//Binary grid cache written next to a parsed .dat file
+//layout: DemCacheHeader followed by rows*cols float heights (row-major)
+struct DemCacheHeader {
+	char magic[4];          //"DEMC"
+	quint32 version;
+	qint32 rows, cols;
+	double originX, originY;
+	double spacingX, spacingY;
+	float minZ, maxZ;
+	quint64 sourceSize;     //size of the .dat the cache was built from
+};
+static_assert(sizeof(DemCacheHeader) == 64, "DemCacheHeader must stay 64 bytes");
+
+class DemCache {
+public:
+	DemCache() = default;
+	DemCache(const DemCache&) = delete;
+	DemCache& operator=(const DemCache&) = delete;
+	~DemCache() { close(); }
+
+	static QString cachePath(const QString& sourcePath) { return sourcePath + ".demc"; }
+	static bool isFresh(const QString& cachePath, const QString& sourcePath);
+	static bool write(const QString& path, const GridInfo& grid, const float* heights, qint64 sourceSize);
+	//header only, for writers that stream the heights (XyzParser::parseToCache)
+	static bool writeHeader(QIODevice& out, const GridInfo& grid, qint64 sourceSize);
+
+	bool open(const QString& path, qint64 sourceSize);
+	void close();
+	bool isOpen() const { return mapped != nullptr; }
+
+	const GridInfo& getGrid() const { return grid; }
+	const float* getHeights() const { return heights; }
+
+private:
+	QFile file;
+	uchar* mapped = nullptr;
+	GridInfo grid;
+	const float* heights = nullptr;
+};
@@ -0,0 +1,51 @@
+#include "FrameArena.h"
+#include <algorithm>
+
+void FrameArena::reset()
+{
+	frameStats = Stats();
+	if (blocks.size() > 1) {
+		size_t total = 0;
+		for (const Block& block : blocks)
+			total += block.size;
+		blocks.clear();
+		blocks.push_back({ std::unique_ptr<char[]>(new char[total]), total });
+	}
+	current = offset = used = 0;
+	frameStats.capacityBytes = blocks.empty() ? 0 : blocks[0].size;
+}
+
+void* FrameArena::allocateBytes(size_t bytes, size_t align)
+{
+	//next block that fits, a new one only past the last
+	while (true) {
+		if (current < blocks.size()) {
+			Block& block = blocks[current];
+			size_t start = (offset + align - 1) & ~(align - 1);
+			if (start + bytes <= block.size) {
+				used += start + bytes - offset;
+				offset = start + bytes;
+				frameStats.peakBytes = std::max(frameStats.peakBytes, used);
+				return block.data.get() + start;
+			}
+			if (current + 1 == blocks.size())
+				break;
+			//the rest of this block stays unused until the scope unwinds
+			used += block.size - offset;
+			current++;
+			offset = 0;
+			continue;
+		}
+		break;
+	}
+
+	size_t size = std::max(blockSize, bytes + align);
+	if (!blocks.empty()) {
+		used += blocks[current].size - offset;
+		current++;
+	}
+	blocks.push_back({ std::unique_ptr<char[]>(new char[size]), size });
+	offset = 0;
+	frameStats.capacityBytes += size;
+	return allocateBytes(bytes, align);
+}
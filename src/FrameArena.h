@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+//Bump allocator for render temporaries, one owner thread
+//reset() at the start of a frame rewinds it, the memory stays for the next frame;
+//Scope rewinds to where it was created, for per polygon / per tile scratch inside a frame
+class FrameArena {
+public:
+	static constexpr size_t blockSize = size_t(1) << 20;
+
+	struct Stats {
+		size_t peakBytes = 0;       //high-water mark of the frame
+		size_t capacityBytes = 0;   //all blocks
+	};
+
+	class Scope {
+	public:
+		explicit Scope(FrameArena& arena) : arena(arena), block(arena.current), offset(arena.offset), used(arena.used) {}
+		~Scope() { arena.current = block; arena.offset = offset; arena.used = used; }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		FrameArena& arena;
+		size_t block, offset, used;
+	};
+
+	//a frame that spilled over several blocks gets them merged into one, nothing is freed otherwise
+	void reset();
+	const Stats& stats() const { return frameStats; }
+
+	//uninitialized, never destructed
+	template <typename T>
+	T* allocate(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without destructors");
+		return static_cast<T*>(allocateBytes(count * sizeof(T), alignof(T)));
+	}
+
+private:
+	struct Block {
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+	void* allocateBytes(size_t bytes, size_t align);
+
+	std::vector<Block> blocks;
+	size_t current = 0, offset = 0;     //bump position
+	size_t used = 0;                    //bytes handed out, blocks before current count in full
+	Stats frameStats;
+};
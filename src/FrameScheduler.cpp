@@ -0,0 +1,70 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+FrameScheduler::FrameScheduler()
+{
+	timer.setSingleShot(true);
+	timer.setTimerType(Qt::PreciseTimer);
+	QObject::connect(&timer, &QTimer::timeout, &timer, [this] { tick(); });
+}
+
+void FrameScheduler::setRefreshRate(double hz)
+{
+	if (hz > 0)
+		intervalMs = 1000.0 / hz;
+}
+
+void FrameScheduler::setCallbacks(std::function<bool()> busy, std::function<void(const NavigationInput&)> flush)
+{
+	this->busy = std::move(busy);
+	this->flush = std::move(flush);
+}
+
+void FrameScheduler::orbit(QPointF pixels)
+{
+	pending.orbit += pixels;
+	schedule();
+}
+
+void FrameScheduler::pan(QPointF pixels)
+{
+	pending.pan += pixels;
+	schedule();
+}
+
+void FrameScheduler::zoom(float factor)
+{
+	pending.zoom *= factor;
+	schedule();
+}
+
+void FrameScheduler::schedule()
+{
+	if (timer.isActive()) return;
+	//one refresh interval after the last flush, at once when that has passed
+	double waitMs = sinceFlush.isValid() ? std::max(0.0, intervalMs - sinceFlush.nsecsElapsed() / 1e6) : 0.0;
+	timer.start(int(std::ceil(waitMs)));
+}
+
+void FrameScheduler::tick()
+{
+	if (pending.isEmpty()) return;
+
+	//the frame in flight finishes first, a frame slower than maxHold is cancelled as before
+	if (busy && busy()) {
+		if (!held.isValid())
+			held.start();
+		if (held.nsecsElapsed() / 1e6 < maxHoldMs) {
+			timer.start(int(std::ceil(intervalMs)));
+			return;
+		}
+	}
+	held.invalidate();
+
+	NavigationInput input = pending;
+	pending = NavigationInput();
+	sinceFlush.start();
+	if (flush)
+		flush(input);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <QTimer>
+#include <QPointF>
+#include <QElapsedTimer>
+#include <functional>
+
+//view input gathered between two frames
+struct NavigationInput {
+	QPointF orbit;          //pixels dragged
+	QPointF pan;            //pixels dragged
+	float zoom = 1.0f;      //product of the wheel steps
+	bool isEmpty() const { return orbit.isNull() && pan.isNull() && zoom == 1.0f; }
+};
+
+//Merges a burst of mouse input into at most one frame request per display refresh, GUI thread only
+//the first input after a quiet spell goes out at once, the rest on the next refresh tick;
+//while a frame is still in flight the input is held (up to maxHold ms) instead of cancelling it
+class FrameScheduler {
+public:
+	FrameScheduler();
+
+	void setRefreshRate(double hz);
+	void setMaxHold(double ms) { maxHoldMs = ms; }
+	//busy = a frame is queued or rendering, flush = post the merged input
+	void setCallbacks(std::function<bool()> busy, std::function<void(const NavigationInput&)> flush);
+
+	void orbit(QPointF pixels);
+	void pan(QPointF pixels);
+	void zoom(float factor);
+
+private:
+	void schedule();
+	void tick();
+
+	QTimer timer;
+	QElapsedTimer sinceFlush, held;
+	NavigationInput pending;
+	double intervalMs = 1000.0 / 60.0;
+	double maxHoldMs = 66.0;
+	std::function<bool()> busy;
+	std::function<void(const NavigationInput&)> flush;
+};
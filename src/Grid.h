@@ -0,0 +1,15 @@
+#pragma once
+#include <QtGlobal>
+
+//Regular row-major height grid: x grows along a row, y from row to row
+struct GridInfo {
+	double originX = 0, originY = 0;
+	double spacingX = 1, spacingY = 1;
+	int rows = 0, cols = 0;
+	float minZ = 0, maxZ = 1;
+
+	qint64 vertexCount() const { return qint64(rows) * cols; }
+	bool isValid() const { return rows > 1 && cols > 1; }
+	double xAt(int col) const { return originX + col * spacingX; }
+	double yAt(int row) const { return originY + row * spacingY; }
+};
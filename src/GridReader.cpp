@@ -0,0 +1,362 @@
+#include "GridReader.h"
+#include "DemCache.h"
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cctype>
+#include <limits>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const qint16 hgtVoid = -32768;
+
+struct AscChunk {
+	const char* begin;
+	const char* end;
+	qint64 values = 0;
+	qint64 offset = 0;   //index of the first value in the body
+	qint64 bad = 0;
+};
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+//voids are NaN here
+static void fillVoids(QVector<float>& heights, qint64 voids)
+{
+	if (voids == 0) return;
+	float* h = heights.data();
+	qint64 n = heights.size();
+
+	//serial, min reductions need OpenMP 3.1 and MSVC /openmp is 2.0
+	float lowest = std::numeric_limits<float>::max();
+	for (qint64 i = 0; i < n; ++i)
+		if (!std::isnan(h[i])) lowest = std::min(lowest, h[i]);
+	if (voids == n) lowest = 0;
+
+	#pragma omp parallel for schedule(static)
+	for (qint64 i = 0; i < n; ++i)
+		if (std::isnan(h[i])) h[i] = lowest;
+	qDebug() << voids << "no data samples set to" << lowest;
+}
+
+bool GridReader::canRead(const QString& path)
+{
+	QString suffix = QFileInfo(path).suffix().toLower();
+	return suffix == "hgt" || suffix == "asc";
+}
+
+bool GridReader::read(QFile& file, GridInfo& grid, QVector<float>& heights)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	bool ok = QFileInfo(file.fileName()).suffix().toLower() == "hgt" ? readHgt(file, grid, heights) : readAsc(file, grid, heights);
+	if (ok)
+		qDebug() << "Read" << grid.cols << "x" << grid.rows << "grid in" << timer.nsecsElapsed() / 1e6 << "ms";
+	return ok;
+}
+
+//size check and the tile corner from the name, side = samples per row and column
+static bool hgtGrid(QFile& file, GridInfo& grid)
+{
+	qint64 size = file.size();
+	int side = int(std::lround(std::sqrt(size / 2.0)));
+	if (side < 2 || qint64(side) * side * 2 != size) {
+		qWarning() << "Not an SRTM tile" << file.fileName();
+		return false;
+	}
+
+	//tile covers [lat, lat + 1] x [lon, lon + 1] degrees, edge samples shared with the neighbours
+	double lat = 0, lon = 0;
+	QRegularExpression corner("^([NS])(\\d{1,2})([EW])(\\d{1,3})", QRegularExpression::CaseInsensitiveOption);
+	QRegularExpressionMatch match = corner.match(QFileInfo(file.fileName()).fileName());
+	if (match.hasMatch()) {
+		lat = match.captured(2).toInt() * (match.captured(1).toUpper() == "S" ? -1 : 1);
+		lon = match.captured(4).toInt() * (match.captured(3).toUpper() == "W" ? -1 : 1);
+	}
+	else
+		qWarning() << "No tile corner in the name, origin at 0, 0";
+
+	grid = GridInfo();
+	grid.originX = lon;
+	grid.originY = lat;
+	grid.spacingX = grid.spacingY = 1.0 / (side - 1);
+	grid.rows = grid.cols = side;
+	return true;
+}
+
+bool GridReader::readHgt(QFile& file, GridInfo& grid, QVector<float>& heights)
+{
+	if (!hgtGrid(file, grid))
+		return false;
+	const int side = grid.cols;
+	qint64 size = file.size();
+
+	QByteArray fallback;
+	uchar* mapped = file.map(0, size);
+	const uchar* data = mapped;
+	if (data == nullptr) {
+		fallback = file.readAll();
+		if (fallback.size() != size) return false;
+		data = reinterpret_cast<const uchar*>(fallback.constData());
+	}
+
+	heights.resize(grid.vertexCount());
+	float* out = heights.data();
+
+	//first file row is the north edge
+	qint64 voids = 0;
+	#pragma omp parallel for reduction(+:voids) schedule(static)
+	for (int r = 0; r < side; ++r) {
+		const uchar* src = data + qint64(side - 1 - r) * side * 2;
+		float* dst = out + qint64(r) * side;
+		for (int c = 0; c < side; ++c) {
+			qint16 v = qFromBigEndian<qint16>(src + 2 * c);
+			if (v == hgtVoid) {
+				dst[c] = std::numeric_limits<float>::quiet_NaN();
+				voids++;
+			}
+			else
+				dst[c] = v;
+		}
+	}
+
+	if (mapped != nullptr)
+		file.unmap(mapped);
+	fillVoids(heights, voids);
+	return true;
+}
+
+bool GridReader::hgtToCache(QFile& file, const QString& cachePath, qint64 sourceSize)
+{
+	GridInfo grid;
+	if (!hgtGrid(file, grid))
+		return false;
+	const int side = grid.cols;
+	const uchar* data = file.map(0, file.size());
+	if (data == nullptr)
+		return false;
+
+	//z range and the void fill value first, per row: min/max reductions are OpenMP 3.1
+	QVector<qint16> rowMin(side), rowMax(side);
+	#pragma omp parallel for schedule(static)
+	for (int r = 0; r < side; ++r) {
+		const uchar* src = data + qint64(r) * side * 2;
+		qint16 lo = std::numeric_limits<qint16>::max(), hi = std::numeric_limits<qint16>::min();
+		for (int c = 0; c < side; ++c) {
+			qint16 v = qFromBigEndian<qint16>(src + 2 * c);
+			if (v == hgtVoid) continue;
+			lo = std::min(lo, v);
+			hi = std::max(hi, v);
+		}
+		rowMin[r] = lo;
+		rowMax[r] = hi;
+	}
+	qint16 lowest = std::numeric_limits<qint16>::max(), highest = std::numeric_limits<qint16>::min();
+	for (int r = 0; r < side; ++r) {
+		lowest = std::min(lowest, rowMin[r]);
+		highest = std::max(highest, rowMax[r]);
+	}
+	if (lowest > highest)
+		lowest = highest = 0;
+	grid.minZ = lowest;
+	grid.maxZ = highest;
+
+	//then one row at a time, south first, voids set to the lowest height
+	QSaveFile out(cachePath);
+	bool ok = out.open(QIODevice::WriteOnly) && DemCache::writeHeader(out, grid, sourceSize);
+	QVector<float> row(side);
+	for (int r = 0; r < side && ok; ++r) {
+		const uchar* src = data + qint64(side - 1 - r) * side * 2;
+		for (int c = 0; c < side; ++c) {
+			qint16 v = qFromBigEndian<qint16>(src + 2 * c);
+			row[c] = v == hgtVoid ? lowest : v;
+		}
+		qint64 bytes = side * qint64(sizeof(float));
+		ok = out.write(reinterpret_cast<const char*>(row.constData()), bytes) == bytes;
+	}
+	file.unmap(const_cast<uchar*>(data));
+
+	if (!ok || !out.commit()) {
+		qWarning() << "Cannot write cache" << cachePath;
+		return false;
+	}
+	return true;
+}
+
+bool GridReader::readAsc(QFile& file, GridInfo& grid, QVector<float>& heights)
+{
+	qint64 size = file.size();
+	QByteArray fallback;
+	uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+	const char* data = reinterpret_cast<const char*>(mapped);
+	if (data == nullptr) {
+		fallback = file.readAll();
+		data = fallback.constData();
+		size = fallback.size();
+	}
+	const char* end = data + size;
+
+	//header lines until the first one starting with a number
+	int cols = 0, rows = 0;
+	double x = 0, y = 0, cellX = 0, cellY = 0;
+	double noData = -9999;
+	bool centered = false, haveNoData = false;
+	const char* p = data;
+	while (p < end) {
+		const char* b = p;
+		while (b < end && isSpace(*b)) ++b;
+		if (b == end || !std::isalpha(uchar(*b))) {
+			p = b;
+			break;
+		}
+		const char* nl = static_cast<const char*>(std::memchr(b, '\n', end - b));
+		const char* lineEnd = nl ? nl : end;
+		QList<QByteArray> parts = QByteArray(b, lineEnd - b).simplified().split(' ');
+		p = nl ? nl + 1 : end;
+		if (parts.size() != 2) {
+			qWarning() << "Bad header line" << QString::fromLatin1(b, lineEnd - b);
+			continue;
+		}
+
+		QByteArray key = parts[0].toLower();
+		bool ok;
+		double value = parts[1].toDouble(&ok);
+		if (!ok) {
+			qWarning() << "Bad header value" << parts[0] << parts[1];
+			continue;
+		}
+		if (key == "ncols") cols = int(value);
+		else if (key == "nrows") rows = int(value);
+		else if (key == "xllcorner" || key == "xllcenter") { x = value; centered = key == "xllcenter"; }
+		else if (key == "yllcorner" || key == "yllcenter") y = value;
+		else if (key == "cellsize") cellX = cellY = value;
+		else if (key == "dx") cellX = value;
+		else if (key == "dy") cellY = value;
+		else if (key == "nodata_value") { noData = value; haveNoData = true; }
+		else qDebug() << "Ignored header key" << parts[0];
+	}
+	if (cols < 2 || rows < 2 || cellX <= 0 || cellY <= 0) {
+		qWarning() << "Not an ASCII grid" << file.fileName();
+		if (mapped != nullptr) file.unmap(mapped);
+		return false;
+	}
+
+	//nodes at the cell centers
+	grid = GridInfo();
+	grid.originX = centered ? x : x + cellX / 2;
+	grid.originY = centered ? y : y + cellY / 2;
+	grid.spacingX = cellX;
+	grid.spacingY = cellY;
+	grid.rows = rows;
+	grid.cols = cols;
+	const qint64 n = grid.vertexCount();
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	const qint64 bodySize = end - p;
+	const qint64 minChunkBytes = 1 << 16;
+	int chunkCount = int(std::max<qint64>(1, std::min<qint64>(qint64(threads) * 4, bodySize / minChunkBytes)));
+
+	//whitespace aligned chunk boundaries, a value never straddles two chunks
+	QVector<AscChunk> chunks(chunkCount);
+	const char* prev = p;
+	for (int i = 0; i < chunkCount; ++i) {
+		const char* split = end;
+		if (i + 1 < chunkCount) {
+			split = std::max(p + bodySize * (i + 1) / chunkCount, prev);
+			while (split < end && !isSpace(*split)) ++split;
+		}
+		chunks[i].begin = prev;
+		chunks[i].end = split;
+		prev = split;
+	}
+
+	//values are not tied to lines, the index of a chunk's first value needs the counts before it
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < chunkCount; ++i) {
+		qint64 count = 0;
+		bool inToken = false;
+		for (const char* c = chunks[i].begin; c < chunks[i].end; ++c) {
+			bool token = !isSpace(*c);
+			count += token && !inToken;
+			inToken = token;
+		}
+		chunks[i].values = count;
+	}
+
+	qint64 total = 0;
+	for (AscChunk& c : chunks) {
+		c.offset = total;
+		total += c.values;
+	}
+	if (total < n) {
+		qWarning() << "ASCII grid has" << total << "of" << n << "values";
+		if (mapped != nullptr) file.unmap(mapped);
+		return false;
+	}
+	if (total > n)
+		qWarning() << "Ignored" << total - n << "values past the grid";
+
+	heights.resize(n);
+	float* out = heights.data();
+	const float noDataValue = float(noData);
+
+	//first body row is the north edge
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < chunkCount; ++i) {
+		AscChunk& chunk = chunks[i];
+		qint64 index = chunk.offset;
+		const char* c = chunk.begin;
+		while (c < chunk.end && index < n) {
+			while (c < chunk.end && isSpace(*c)) ++c;
+			if (c == chunk.end) break;
+			const char* tokEnd = c;
+			while (tokEnd < chunk.end && !isSpace(*tokEnd)) ++tokEnd;
+
+			double value;
+			auto result = std::from_chars(*c == '+' ? c + 1 : c, tokEnd, value);
+			float h = float(value);
+			if (result.ec != std::errc() || result.ptr != tokEnd) {
+				h = std::numeric_limits<float>::quiet_NaN();
+				chunk.bad++;
+			}
+			else if (haveNoData && h == noDataValue)
+				h = std::numeric_limits<float>::quiet_NaN();
+
+			qint64 row = index / cols;
+			out[(rows - 1 - row) * cols + index % cols] = h;
+			index++;
+			c = tokEnd;
+		}
+	}
+
+	if (mapped != nullptr)
+		file.unmap(mapped);
+
+	qint64 bad = 0;
+	for (const AscChunk& c : chunks)
+		bad += c.bad;
+	if (bad > 0)
+		qWarning() << bad << "unreadable values";
+
+	qint64 voids = 0;
+	#pragma omp parallel for reduction(+:voids) schedule(static)
+	for (qint64 i = 0; i < n; ++i)
+		voids += std::isnan(out[i]);
+	fillVoids(heights, voids);
+	return true;
+}
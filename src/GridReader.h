@@ -0,0 +1,22 @@
+#pragma once
+#include <QFile>
+#include <QVector>
+#include "Grid.h"
+
+//Raster DEM loaders, heights come out row-major from the south row like a parsed XYZ grid
+//no data samples are filled with the lowest valid height
+class GridReader {
+public:
+	//by suffix: .hgt, .asc
+	static bool canRead(const QString& path);
+	static bool read(QFile& file, GridInfo& grid, QVector<float>& heights);
+
+	//SRTM tile: square big-endian int16 from the north row, lower left corner from the name (N45E006.hgt)
+	//every sample is swapped out of the mapped file into heights, a float copy of twice the file size
+	static bool readHgt(QFile& file, GridInfo& grid, QVector<float>& heights);
+	//same tile swapped row by row straight into a .demc cache, no full copy; mapped afterwards like a parsed grid
+	static bool hgtToCache(QFile& file, const QString& cachePath, qint64 sourceSize);
+	//ESRI ASCII grid: "key value" header, then nrows x ncols values from the north row
+	//mapped body split into whitespace aligned chunks, counted and parsed in parallel
+	static bool readAsc(QFile& file, GridInfo& grid, QVector<float>& heights);
+};
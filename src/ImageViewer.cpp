@@ -12,6 +12,16 @@ ImageViewer::ImageViewer(QWidget* parent)
 	ui->scrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
 	ui->scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
 
+	//memory budget for paged DEM tiles (MB)
+	vW->setTileCacheBudget(qint64(settings.value("tile_cache_mb", 256).toInt()) * 1024 * 1024);
+	//frame time target while rotating / zooming (ms), previews get coarser to hold it
+	vW->setFrameBudget(settings.value("frame_budget_ms", 33.0).toDouble());
+	//reference paths for comparing output, the toggled slots pass them on and store them
+	ui->actionDepthTest->setChecked(settings.value("depth_test", true).toBool());
+	ui->actionCullBackFaces->setChecked(settings.value("cull_back_faces", true).toBool());
+	ui->actionParallelRaster->setChecked(settings.value("parallel_raster", true).toBool());
+	ui->actionSimdRaster->setChecked(settings.value("simd_raster", true).toBool());
+
 	vW->setObjectName("ViewerWidget");
 	vW->installEventFilter(this);
 
@@ -27,6 +37,31 @@ ImageViewer::ImageViewer(QWidget* parent)
 
 	connect(ui->rotZSpin, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
 		vW, &ViewerWidget::setModelRotationZ);
+
+	connect(ui->lodSpin, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+		vW, &ViewerWidget::setLodTolerance);
+
+	//item index = RenderMode
+	for (int i = 0; i < ModeCount; ++i)
+		ui->renderModeCombo->addItem(Renderer::renderModeName(i));
+	connect(ui->renderModeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+		vW, &ViewerWidget::setRenderMode);
+
+	//built-in color ramps, item index = ColorRamp
+	for (int i = 0; i < int(ColorRamp::Count); ++i)
+		ui->colorMapCombo->addItem(ColorLut::rampName(ColorRamp(i)));
+	connect(ui->colorMapCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+		vW, &ViewerWidget::setColorRamp);
+
+	connect(ui->smoothCheck, &QCheckBox::toggled, vW, &ViewerWidget::setSmoothShading);
+
+	//mouse orbit moves the spinboxes without feeding the rotation back
+	connect(vW, &ViewerWidget::rotationChanged, this, [this](QVector3D rotation) {
+		QSignalBlocker blockX(ui->rotXSpin), blockY(ui->rotYSpin), blockZ(ui->rotZSpin);
+		ui->rotXSpin->setValue(rotation.x());
+		ui->rotYSpin->setValue(rotation.y());
+		ui->rotZSpin->setValue(rotation.z());
+	});
 }
 
 // Event filters
@@ -84,14 +119,31 @@ void ImageViewer::ViewerWidgetMouseButtonPress(ViewerWidget* w, QEvent* event)
 			w->update();
 		}
 	}*/
+	//left drag orbits, right / middle drag pans
+	if (e->button() == Qt::LeftButton || e->button() == Qt::RightButton || e->button() == Qt::MiddleButton) {
+		lastMousePos = e->position().toPoint();
+		w->setCursor(e->button() == Qt::LeftButton ? Qt::ClosedHandCursor : Qt::SizeAllCursor);
+	}
 }
 void ImageViewer::ViewerWidgetMouseButtonRelease(ViewerWidget* w, QEvent* event)
 {
 	QMouseEvent* e = static_cast<QMouseEvent*>(event);
+	if (e->buttons() == Qt::NoButton)
+		w->unsetCursor();
 }
 void ImageViewer::ViewerWidgetMouseMove(ViewerWidget* w, QEvent* event)
 {
 	QMouseEvent* e = static_cast<QMouseEvent*>(event);
+	if (!(e->buttons() & (Qt::LeftButton | Qt::RightButton | Qt::MiddleButton)))
+		return;
+
+	//only accumulated here, the scheduler turns a burst of moves into one frame
+	QPoint delta = e->position().toPoint() - lastMousePos;
+	lastMousePos = e->position().toPoint();
+	if (e->buttons() & Qt::LeftButton)
+		w->orbitBy(delta);
+	else
+		w->panBy(delta);
 }
 void ImageViewer::ViewerWidgetLeave(ViewerWidget* w, QEvent* event)
 {
@@ -102,14 +154,8 @@ void ImageViewer::ViewerWidgetEnter(ViewerWidget* w, QEvent* event)
 void ImageViewer::ViewerWidgetWheel(ViewerWidget* w, QEvent* event)
 {
 	QWheelEvent* wheelEvent = static_cast<QWheelEvent*>(event);
-	if (wheelEvent->angleDelta().y() > 0)
-		vW->getModel().getModelScale() *= 1.1f;
-	else
-		vW->getModel().getModelScale() /= 1.1f;
-	qDebug() << "Mouse";
-	vW->clear();
-	vW->showModel();
-	update();
+	//camera zoom, the fit to screen no longer cancels it; 1.1 per notch (120), touchpads send fractions
+	w->zoomBy(std::pow(1.1f, wheelEvent->angleDelta().y() / 120.0f));
 }
 
 //ImageViewer Events
@@ -128,7 +174,8 @@ void ImageViewer::closeEvent(QCloseEvent* event)
 bool ImageViewer::openImage(QString filename)
 {
 	QFile file(filename);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+	//no Text mode, .hgt tiles are binary
+	if (!file.open(QIODevice::ReadOnly)) {
 		return false;
 		
 	}
@@ -141,8 +188,9 @@ bool ImageViewer::saveImage(QString filename)
 	QFileInfo fi(filename);
 	QString extension = fi.completeSuffix();
 
-	QImage* img = vW->getImage();
-	return img->save(filename, extension.toStdString().c_str());
+	//copy of the shown frame, the render thread keeps drawing into the back buffer
+	QImage img = vW->grabFrame();
+	return img.save(filename, extension.toStdString().c_str());
 }
 
 //Slots
@@ -150,7 +198,7 @@ void ImageViewer::on_actionOpen_triggered()
 {
 	QString folder = settings.value("folder_img_load_path", "").toString();
 
-	QString fileFilter = "Image data (*.dat);;All files (*)";
+	QString fileFilter = "Elevation data (*.dat *.hgt *.asc);;XYZ points (*.dat);;SRTM tiles (*.hgt);;ESRI ASCII grids (*.asc);;All files (*)";
 	QString fileName = QFileDialog::getOpenFileName(this, "Load image", folder, fileFilter);
 	if (fileName.isEmpty()) { return; }
 
@@ -188,6 +236,49 @@ void ImageViewer::on_actionClear_triggered()
 {
 	vW->clear();
 }
+void ImageViewer::on_actionProfilerHud_toggled(bool checked)
+{
+	vW->setShowHud(checked);
+}
+void ImageViewer::on_actionDepthTest_toggled(bool checked)
+{
+	settings.setValue("depth_test", checked);
+	vW->setDepthTest(checked);
+}
+void ImageViewer::on_actionCullBackFaces_toggled(bool checked)
+{
+	settings.setValue("cull_back_faces", checked);
+	vW->setCullBackFaces(checked);
+}
+void ImageViewer::on_actionParallelRaster_toggled(bool checked)
+{
+	settings.setValue("parallel_raster", checked);
+	vW->setParallelRaster(checked);
+}
+void ImageViewer::on_actionSimdRaster_toggled(bool checked)
+{
+	settings.setValue("simd_raster", checked);
+	vW->setSimdRaster(checked);
+}
+void ImageViewer::on_actionExportTrace_triggered()
+{
+	QString folder = settings.value("folder_trace_save_path", "").toString();
+
+	QString fileFilter = "Chrome trace (*.json);;All files (*)";
+	QString fileName = QFileDialog::getSaveFileName(this, "Export frame trace", folder, fileFilter);
+	if (fileName.isEmpty()) return;
+	settings.setValue("folder_trace_save_path", QFileInfo(fileName).absoluteDir().absolutePath());
+
+	if (!vW->exportTrace(fileName)) {
+		msgBox.setText("Unable to write trace.");
+		msgBox.setIcon(QMessageBox::Warning);
+	}
+	else {
+		msgBox.setText(QString("Trace %1 saved, open it in chrome://tracing or ui.perfetto.dev.").arg(fileName));
+		msgBox.setIcon(QMessageBox::Information);
+	}
+	msgBox.exec();
+}
 void ImageViewer::on_actionExit_triggered()
 {
 	this->close();
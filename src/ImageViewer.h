@@ -21,6 +21,7 @@ private:
 	ViewerWidget* vW;
 
 	QColor globalColor;
+	QPoint lastMousePos;    //orbit / pan drag
 	QSettings settings;
 	QMessageBox msgBox;
 
@@ -50,6 +51,12 @@ private slots:
 	void on_actionSave_as_triggered();
 	void on_actionClear_triggered();
 	void on_actionExit_triggered();
+	void on_actionProfilerHud_toggled(bool checked);
+	void on_actionExportTrace_triggered();
+	void on_actionDepthTest_toggled(bool checked);
+	void on_actionCullBackFaces_toggled(bool checked);
+	void on_actionParallelRaster_toggled(bool checked);
+	void on_actionSimdRaster_toggled(bool checked);
 
 };
 
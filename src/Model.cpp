@@ -1,140 +1,250 @@
 ﻿#include "Model.h"
+#include "Delaunay.h"
 #include <QDebug>
+#include <algorithm>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-void Model::setupModel()
-{
-	edgesSetup();
-	//edgesPrint();
 
+void Model::clear()
+{
+	ownedHeights.clear();
+	heights = nullptr;
+	grid = GridInfo();
+	normals.clear();
+	cache.close();
 }
 
-void Model::printPoints()
+void Model::setupModel()
 {
-	for (auto& x : getPoints())
-	{
-		qDebug() << x.x << x.y << x.z;
-	}
+	computeZRange();
+	qDebug() << "Rows" << grid.rows << " Cols" << grid.cols;
 }
 
-
-
-void Model::edgesSetup()
+void Model::generateTestGrid(int rows, int cols, double spacing)
 {
-	size_t i = 0, j = 0, k = 0;
-	int rows = 0, cols = 1;
-	bool isLastEdge = false;
-
-	while (i + 1 < points.size())
-	{
-		Point& first = points[i];
-		Point& second = points[i + 1];
-
-		constexpr double EPS = 1e-6;
-		
-		if (std::abs(first.y - second.y) < EPS)
-		{
-			edges.append(std::pair<Point*, Point*>(&points[i], &points[i + 1]));
-		}
-		else
-		{
-			if (isLastEdge)
-			{
-				edges.append(std::pair<Point*, Point*>(&points[k], &points[i]));
-				k = i;
-			}
-			else
-			{
-				isLastEdge = true;
-				k = i;
-				rows = i + 1;
-			}
-
-			edges.append(std::pair<Point*, Point*>(&points[j], &points[i + 1]));
-			j = i + 1;
-			cols++;
+	clear();
+	grid.spacingX = grid.spacingY = spacing;
+	grid.rows = rows;
+	grid.cols = cols;
+	ownedHeights.resize(grid.vertexCount());
+	float* out = ownedHeights.data();
+
+	//two octaves of sines, a few hills across the grid whatever its size
+	#pragma omp parallel for schedule(static)
+	for (int r = 0; r < rows; ++r) {
+		float v = float(r) / rows;
+		for (int c = 0; c < cols; ++c) {
+			float u = float(c) / cols;
+			out[qint64(r) * cols + c] = float(200.0 * std::sin(u * 12.0) * std::cos(v * 9.0)
+				+ 40.0 * std::sin(u * 61.0 + v * 47.0) + 300.0);
 		}
-		++i;
 	}
-	qDebug() << "Rows" << rows << " Cols" << cols;
-	polygonsSetup(rows, cols);
+	heights = ownedHeights.constData();
+	computeZRange();
 }
 
+bool Model::buildGrid(const QVector<Point>& points)
+{
+	clear();
+
+	//cols = points until y changes
+	int n = points.size();
+	int cols = 1;
+	while (cols < n && std::abs(points[cols].y - points[0].y) < 1e-9)
+		cols++;
+
+	if (cols < 2 || cols == n || n % cols != 0)
+		return buildScattered(points);
+	int rows = n / cols;
+
+	grid.originX = points[0].x;
+	grid.originY = points[0].y;
+	grid.spacingX = (points[cols - 1].x - points[0].x) / (cols - 1);
+	grid.spacingY = (points[(rows - 1) * cols].y - points[0].y) / (rows - 1);
+	grid.rows = rows;
+	grid.cols = cols;
+
+	//row and column counts can fit by chance, every point has to sit on its node
+	double tolX = 0.1 * std::abs(grid.spacingX), tolY = 0.1 * std::abs(grid.spacingY);
+	qint64 offGrid = 0;
+	#pragma omp parallel for reduction(+:offGrid) schedule(static)
+	for (int i = 0; i < n; ++i) {
+		if (std::abs(points[i].x - grid.xAt(i % cols)) > tolX || std::abs(points[i].y - grid.yAt(i / cols)) > tolY)
+			offGrid++;
+	}
+	if (offGrid > 0 || tolX == 0 || tolY == 0) {
+		grid = GridInfo();
+		return buildScattered(points);
+	}
 
+	ownedHeights.resize(n);
+	for (int i = 0; i < n; ++i)
+		ownedHeights[i] = float(points[i].z);
+	heights = ownedHeights.constData();
 
-void Model::polygonsSetup(int rows, int cols)
+	computeZRange();
+	return true;
+}
+
+bool Model::buildScattered(const QVector<Point>& points)
 {
-	for (size_t i = 0; i < rows - 1; ++i)
-	{
-		for (size_t j = 0; j < cols - 1; ++j)
-		{
-			size_t idx = i * cols + j;
+	clear();
 
-			Point* A = &points[idx];
-			Point* B = &points[idx + 1];
-			Point* C = &points[idx + cols + 1];
-			Point* D = &points[idx + cols];
+	Delaunay tin;
+	if (!tin.build(points)) {
+		qWarning() << "Not enough distinct points to triangulate";
+		return false;
+	}
 
-			polygons.append({ A, B, C, D });
-		}
+	//resample the TIN onto a grid of about one node per point
+	double width = tin.maxX() - tin.minX(), height = tin.maxY() - tin.minY();
+	double area = width > 0 && height > 0 ? width * height : std::max(width, height) * std::max(width, height);
+	double spacing = std::sqrt(area / tin.vertexCount());
+	//a long thin spread would get a very fine grid, cap the node count per axis
+	spacing = std::max({ spacing, width / 65535, height / 65535 });
+
+	grid.originX = tin.minX();
+	grid.originY = tin.minY();
+	grid.spacingX = grid.spacingY = spacing;
+	grid.cols = std::max(2, int(std::ceil(width / spacing)) + 1);
+	grid.rows = std::max(2, int(std::ceil(height / spacing)) + 1);
+
+	ownedHeights.resize(grid.vertexCount());
+	float* out = ownedHeights.data();
+	const int cols = grid.cols;
+	//consecutive nodes of a row fall in the same or a neighbouring triangle, the walk restarts from the last one
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (int r = 0; r < grid.rows; ++r) {
+		int hint = -1;
+		for (int c = 0; c < cols; ++c)
+			out[qint64(r) * cols + c] = tin.heightAt(grid.xAt(c), grid.yAt(r), hint);
 	}
+	heights = ownedHeights.constData();
+
 	computeZRange();
+	qDebug() << "Scattered input:" << tin.vertexCount() << "points," << tin.triangleCount() << "triangles, resampled to"
+		<< grid.cols << "x" << grid.rows;
+	return true;
 }
 
-void Model::edgesPrint()
+bool Model::setHeights(const GridInfo& info, const QVector<float>& values)
 {
-	for (auto& x : edges)
-	{
-		qDebug() << x.first->x << x.first->y << x.first->z << "//" << x.second->x << x.second->y << x.second->z;
+	clear();
+	if (!info.isValid() || values.size() != info.vertexCount()) {
+		qWarning() << "Height count does not match the grid";
+		return false;
 	}
+
+	grid = info;
+	ownedHeights = values;
+	heights = ownedHeights.constData();
+	computeZRange();
+	return true;
 }
 
+bool Model::loadCache(const QString& path, qint64 sourceSize)
+{
+	clear();
+	if (!cache.open(path, sourceSize))
+		return false;
+
+	//no copy, heights point into the mapped file
+	grid = cache.getGrid();
+	heights = cache.getHeights();
+	return true;
+}
 
-void Model::generateTestGrid(int rows, int cols, double spacing)
+bool Model::saveCache(const QString& path, qint64 sourceSize)
 {
-	points.clear();
-	polygons.clear(); 
+	if (heights == nullptr)
+		return false;
+	return DemCache::write(path, grid, heights, sourceSize);
+}
 
-	
-	for (int i = 0; i < rows; ++i) {
-		for (int j = 0; j < cols; ++j) {
-			points.append(Point(j * spacing, i * spacing, 0.0));
-		}
-	}
+bool Model::moveToCache(const QString& path, qint64 sourceSize)
+{
+	if (isMapped())
+		return true;
+	if (!saveCache(path, sourceSize) || !cache.open(path, sourceSize))
+		return false;
+	heights = cache.getHeights();
+	ownedHeights = QVector<float>();
+	return true;
+}
 
-	for (int i = 0; i < rows - 1; ++i) {
-		for (int j = 0; j < cols - 1; ++j) {
-			int idx = i * cols + j;
-			QVector<Point*> polygon;
-			polygon << &points[idx]
-				<< &points[idx + 1]
-				<< &points[idx + cols + 1]
-				<< &points[idx + cols];
-			polygons.append(polygon);
-		}
-	}
+void Model::share(const Model& other)
+{
+	clear();
+	grid = other.grid;
+	//implicitly shared, heights may also point into other's mapped cache
+	ownedHeights = other.ownedHeights;
+	heights = other.heights;
+	normals = other.normals;
+
+	modelRotation = other.modelRotation;
+	modelTranslation = other.modelTranslation;
+	modelScale = other.modelScale;
+	zScaleFactor = other.zScaleFactor;
 }
 
 void Model::computeZRange()
 {
-	if (points.isEmpty()) return;
-	minZ = maxZ = points[0].z;
-	for (const Point& p : points) {
-		if (p.z < minZ) 
-			minZ = p.z;
-		if (p.z > maxZ) 
-			maxZ = p.z;
-	}
+	if (heights == nullptr) return;
+	auto range = std::minmax_element(heights, heights + grid.vertexCount());
+	grid.minZ = *range.first;
+	grid.maxZ = *range.second;
 }
 
-QVector3D Model::computeNormal(const QVector<Point*>& poly)
+void Model::computeNormals()
 {
-	if (poly.size() < 3) return QVector3D(0, 0, 1);
+	normals.clear();
+	if (heights == nullptr || !grid.isValid()) return;
+
+	normals.resize(grid.vertexCount());
+	quint32* out = normals.data();
+	const int rows = grid.rows, cols = grid.cols;
+
+	//central differences inside, one sided on the border
+	#pragma omp parallel for schedule(static)
+	for (int r = 0; r < rows; ++r) {
+		int rPrev = std::max(r - 1, 0), rNext = std::min(r + 1, rows - 1);
+		const float* row = heights + qint64(r) * cols;
+		const float* prev = heights + qint64(rPrev) * cols;
+		const float* next = heights + qint64(rNext) * cols;
+		float dy = float((rNext - rPrev) * grid.spacingY);
+
+		for (int c = 0; c < cols; ++c) {
+			int cPrev = std::max(c - 1, 0), cNext = std::min(c + 1, cols - 1);
+			float dx = float((cNext - cPrev) * grid.spacingX);
+			float gx = (row[cNext] - row[cPrev]) / dx;
+			float gy = (next[c] - prev[c]) / dy;
+
+			QVector3D n = QVector3D(-gx, -gy, 1.0f).normalized();
+			qint16 nx = qint16(std::lround(n.x() * 32767.0f));
+			qint16 ny = qint16(std::lround(n.y() * 32767.0f));
+			out[qint64(r) * cols + c] = quint32(quint16(nx)) | (quint32(quint16(ny)) << 16);
+		}
+	}
+}
 
-	QVector3D A(poly[0]->x, poly[0]->y, poly[0]->z);
-	QVector3D B(poly[1]->x, poly[1]->y, poly[1]->z);
-	QVector3D C(poly[2]->x, poly[2]->y, poly[2]->z);
+QMatrix4x4 Model::modelMatrix()
+{
+	QMatrix4x4 mat;
+	mat.translate(modelTranslation);
+	mat.rotate(modelRotation.x(), 1, 0, 0);
+	mat.rotate(modelRotation.y(), 0, 1, 0);
+	mat.rotate(modelRotation.z(), 0, 0, 1);
+	mat.scale(modelScale, modelScale, modelScale * zScaleFactor);
+	//heights are divided by modelScale before the transform
+	mat.scale(1.0f, 1.0f, 1.0f / modelScale);
+	return mat;
+}
 
+QVector3D Model::computeNormal(const QVector3D& A, const QVector3D& B, const QVector3D& C)
+{
 	QVector3D u = B - A;
 	QVector3D v = C - A;
 	return QVector3D::crossProduct(u, v).normalized();
@@ -189,6 +299,16 @@ QVector3D Camera::transform(QVector3D point)
 	return QVector3D(x, y, z);
 }
 
+QMatrix4x4 Camera::viewMatrix()
+{
+	//rows u, v, -n: projected x, y and depth growing away from the camera
+	return QMatrix4x4(
+		u.x(), u.y(), u.z(), -QVector3D::dotProduct(u, position),
+		v.x(), v.y(), v.z(), -QVector3D::dotProduct(v, position),
+		-n.x(), -n.y(), -n.z(), QVector3D::dotProduct(n, position),
+		0, 0, 0, 1);
+}
+
 QVector3D Camera::project(QVector3D cameraPoint)
 {
 	/*float x = cameraPoint.x() / scale;
@@ -204,15 +324,15 @@ QPointF Camera::toScreenCoordinatesCentered(QVector3D projected, int screenWidth
 	return QPointF(x, y);
 }
 
-QVector<QPointF> Camera::toScreenCoordinates(QVector<Point>& points, int screenWidth, int screenHeight, float margin)
+QVector<QPointF> Camera::toScreenCoordinates(const QVector<QVector3D>& points, int screenWidth, int screenHeight, float margin)
 {
 	if (points.isEmpty()) return {};
 
 	//to camera system
 	QVector<QVector3D> cameraPoints;
 	cameraPoints.reserve(points.size());
-	for (const Point& pt : points) {
-		cameraPoints.append(transform(QVector3D(pt.x, pt.y, pt.z)));
+	for (const QVector3D& pt : points) {
+		cameraPoints.append(transform(pt));
 	}
 
 	//bounding box
@@ -1,12 +1,16 @@
 #pragma once
-#include <QtWidgets>
+#include <QtGui>
 #include <QVector>
 #include <QColor>
+#include <cmath>
+#include "Grid.h"
+#include "DemCache.h"
 
+//parsed XYZ record
 struct Point {
+	Point() : x{ 0 }, y{ 0 }, z{ 0 } {}
 	Point(double _x, double _y, double _z) : x{ _x }, y{ _y }, z{ _z } {}
 	double x, y, z;
-	double nx = 0, ny = 0, nz = 0;
 	void print() { qDebug() << x << y << z; }
 
 };
@@ -31,37 +35,66 @@ public:
 
 	QVector3D project(QVector3D cameraPoint);
 	QPointF toScreenCoordinatesCentered(QVector3D projected, int screenWidth, int screenHeight);
-	QVector<QPointF> toScreenCoordinates(QVector<Point>& points, int screenWidth, int screenHeight, float margin);
+	QVector<QPointF> toScreenCoordinates(const QVector<QVector3D>& points, int screenWidth, int screenHeight, float margin);
+	QMatrix4x4 viewMatrix();
 	QVector3D getPosition() { return position; };
 	QVector3D getU() { return u; }
 	QVector3D getN() { return n; }
 	QVector3D getV() { return v; }
 	QVector3D getLightPosition() { return lightPos; };
+	void setLightPosition(const QVector3D& position) { lightPos = position; }
+	float getZoom() { return zoom; }
+	void setZoom(float value) { zoom = value; }
 private:
 	QVector3D n, u, v;
 	QVector3D position;
 	Angles angles;
+	float zoom = 1.0f;  //on top of the fit to screen
 
 	QVector3D lightPos = QVector3D(0, 0, 200);
 };
 
 class Model {
 public:
+	void clear();
 	void setupModel();
-	void printPoints();
-	void edgesSetup();
-	void polygonsSetup(int rows, int cols);
-	void edgesPrint();
-
-	QVector<Point>& getPoints() { return points; }
-	QVector<std::pair<Point*, Point*>>& getEdges() { return edges; }
-	QVector<QVector<Point*>>& getPolygons() { return polygons; }
 
+	//rolling hills, deterministic, for benchmarks
 	void generateTestGrid(int rows, int cols, double spacing);
 	void computeZRange();
-	float normalizeZ(float z) {	return (z - minZ) / (maxZ - minZ);}
-
-	QVector3D computeNormal(const QVector<Point*>& poly);
+	float normalizeZ(float z) {	return (z - grid.minZ) / (grid.maxZ - grid.minZ);}
+
+	QVector3D computeNormal(const QVector3D& A, const QVector3D& B, const QVector3D& C);
+
+	//Grid: vertex i = row i / cols, col i % cols, cell i has corners i, i+1, i+cols+1, i+cols
+	//falls back to buildScattered when the points are not a complete row-major grid
+	bool buildGrid(const QVector<Point>& points);
+	//irregular points: Delaunay triangulation resampled to a grid of about one node per point
+	bool buildScattered(const QVector<Point>& points);
+	//heights already on a grid (raster readers), values are implicitly shared
+	bool setHeights(const GridInfo& info, const QVector<float>& values);
+	bool loadCache(const QString& path, qint64 sourceSize);
+	bool saveCache(const QString& path, qint64 sourceSize);
+	//heights held in memory are written to the cache and mapped from it, unchanged when that fails
+	bool moveToCache(const QString& path, qint64 sourceSize);
+	//same heights and normals as other without a copy, other has to outlive this
+	void share(const Model& other);
+	bool isEmpty() { return heights == nullptr; }
+	//heights point into the mapped cache, nothing held in memory
+	bool isMapped() { return cache.isOpen(); }
+	const GridInfo& getGrid() { return grid; }
+	const float* getHeights() { return heights; }
+	QVector3D vertex(qint64 index) { return QVector3D(grid.xAt(int(index % grid.cols)), grid.yAt(int(index / grid.cols)), heights[index]); }
+
+	//per vertex unit normals from central differences, x/y packed as int16, z > 0 on a height field
+	void computeNormals();
+	bool hasNormals() { return !normals.isEmpty(); }
+	QVector3D normal(qint64 index) const {
+		quint32 packed = normals[index];
+		float nx = qint16(packed & 0xffff) / 32767.0f;
+		float ny = qint16(packed >> 16) / 32767.0f;
+		return QVector3D(nx, ny, std::sqrt(std::max(0.0f, 1.0f - nx * nx - ny * ny)));
+	}
 
 	QVector3D getModelRotation() { return modelRotation; }
 	QVector3D getModelTranslation() { return modelTranslation; }
@@ -69,64 +102,17 @@ public:
 	float& getZScaleFactor() { return zScaleFactor; }
 	void setModelRotation(QVector3D rot) { modelRotation = rot; }
 	void setModelTranslation(QVector3D transl) { modelTranslation = transl; }
+	QMatrix4x4 modelMatrix();
 
 private:
-	QVector<Point> points;
-	QVector<std::pair<Point*, Point*>> edges;
-	QVector<QVector<Point*>> polygons;
-	double minZ = 0, maxZ = 1;
-
+	GridInfo grid;
+	QVector<float> ownedHeights;
+	const float* heights = nullptr; //ownedHeights or mapped cache
+	DemCache cache;
+	QVector<quint32> normals;
 
 	QVector3D modelRotation = QVector3D(0, 0, 0); //X, Y, Z
 	QVector3D modelTranslation = QVector3D(0, 0, 0); 
 	float modelScale = 1000.0f;        
 	float zScaleFactor = 1.0f;
 };
-
-
-
-
-
-
-
-
-
-
-struct ColorPoint {
-	float x;       //[0, 1]
-	QColor color;
-};
-
-class ColorMap {
-public:
-	void addPoint(float x, const QColor& color) {
-		points.append({ x, color });
-		std::sort(points.begin(), points.end(), [](const ColorPoint& a, const ColorPoint& b) {
-			return a.x < b.x;
-			});
-	}
-
-	QColor getColor(float x) const {
-		if (points.isEmpty()) return QColor(0, 0, 0);
-
-		if (x <= points.first().x) return points.first().color;
-		if (x >= points.last().x) return points.last().color;
-
-		for (int i = 0; i < points.size() - 1; ++i) {
-			if (x >= points[i].x && x <= points[i + 1].x) {
-				float t = (x - points[i].x) / (points[i + 1].x - points[i].x);
-				const QColor& c1 = points[i].color;
-				const QColor& c2 = points[i + 1].color;
-				int r = c1.red() + t * (c2.red() - c1.red());
-				int g = c1.green() + t * (c2.green() - c1.green());
-				int b = c1.blue() + t * (c2.blue() - c1.blue());
-				return QColor(r, g, b);
-			}
-		}
-
-		return QColor(0, 0, 0);
-	}
-
-private:
-	QVector<ColorPoint> points;
-};
\ No newline at end of file
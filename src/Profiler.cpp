@@ -0,0 +1,131 @@
+#include "Profiler.h"
+#include <QFile>
+#include <QDebug>
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+
+int Profiler::threadIndex()
+{
+	//small stable ids for the trace, in order of first use
+	static std::atomic<int> next{ 0 };
+	thread_local int index = next++;
+	return index;
+}
+
+void Profiler::record(const char* name, qint64 startNs, qint64 endNs)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (pending.size() >= maxPending)
+		pending.removeFirst();
+	pending.append({ name, threadIndex(), startNs, endNs - startNs });
+}
+
+void Profiler::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	frameStart = now();
+	frameThread = threadIndex();
+}
+
+void Profiler::cancelFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	//the render thread's scopes since beginFrame, blits of the GUI thread stay
+	pending.erase(std::remove_if(pending.begin(), pending.end(), [this](const ProfileEvent& event) {
+		return event.thread == frameThread && event.startNs >= frameStart;
+	}), pending.end());
+}
+
+void Profiler::endFrame(qint64 polygons, qint64 pixels, qint64 allocations, qint64 arenaBytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	FrameProfile frame;
+	frame.index = frameCount++;
+	frame.thread = threadIndex();
+	frame.startNs = frameStart;
+	frame.durationNs = now() - frameStart;
+	frame.polygons = polygons;
+	frame.pixels = pixels;
+	frame.allocations = allocations;
+	frame.arenaBytes = arenaBytes;
+	frame.events.swap(pending);
+
+	frames.append(frame);
+	//the oldest frame's event list becomes the next pending one, a full history records without allocating
+	while (frames.size() > historySize) {
+		pending.swap(frames.first().events);
+		pending.clear();
+		frames.removeFirst();
+	}
+}
+
+void Profiler::addAllocations(qint64 allocations)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!frames.isEmpty() && frames.last().allocations >= 0)
+		frames.last().allocations += allocations;
+}
+
+FrameProfile Profiler::lastFrame() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return frames.isEmpty() ? FrameProfile() : frames.last();
+}
+
+void Profiler::setHistorySize(int frameCount)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	historySize = std::max(frameCount, 1);
+	while (frames.size() > historySize)
+		frames.removeFirst();
+}
+
+bool Profiler::writeChromeTrace(const QString& path) const
+{
+	QVector<FrameProfile> copy;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		copy = frames;
+	}
+
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		qWarning() << "Cannot write" << path;
+		return false;
+	}
+
+	//timestamps in microseconds, "X" = complete event with a duration
+	char line[256];
+	bool first = true;
+	auto write = [&](int n) {
+		if (!first) file.write(",\n");
+		first = false;
+		file.write(line, std::min(n, int(sizeof(line)) - 1));
+	};
+
+	file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (const FrameProfile& frame : copy) {
+		write(std::snprintf(line, sizeof(line),
+			"{\"name\":\"frame %d\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+			"\"args\":{\"polygons\":%lld,\"pixels\":%lld}}",
+			frame.index, frame.thread, frame.startNs / 1000.0, frame.durationNs / 1000.0,
+			(long long)frame.polygons, (long long)frame.pixels));
+		//"C" = counter track, allocations only when they were counted
+		if (frame.allocations >= 0)
+			write(std::snprintf(line, sizeof(line),
+				"{\"name\":\"memory\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"allocations\":%lld,\"arena_kb\":%lld}}",
+				frame.startNs / 1000.0, (long long)frame.allocations, (long long)(frame.arenaBytes / 1024)));
+		else
+			write(std::snprintf(line, sizeof(line),
+				"{\"name\":\"memory\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"arena_kb\":%lld}}",
+				frame.startNs / 1000.0, (long long)(frame.arenaBytes / 1024)));
+		for (const ProfileEvent& event : frame.events)
+			write(std::snprintf(line, sizeof(line),
+				"{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, event.thread, event.startNs / 1000.0, event.durationNs / 1000.0));
+	}
+	file.write("\n]}\n");
+	qDebug() << "Trace:" << copy.size() << "frames written to" << path;
+	return true;
+}
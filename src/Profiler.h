@@ -0,0 +1,69 @@
+#pragma once
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include <mutex>
+
+struct ProfileEvent {
+	const char* name;       //string literal
+	int thread;             //Profiler::threadIndex()
+	qint64 startNs, durationNs;
+};
+
+//one finished frame, events = scopes closed since the previous frame (load and blit included)
+struct FrameProfile {
+	int index = 0;
+	int thread = 0;
+	qint64 startNs = 0, durationNs = 0;
+	qint64 polygons = 0, pixels = 0;
+	qint64 allocations = 0, arenaBytes = 0;   //heap allocations of the frame (-1 = not counted), frame arena high-water mark
+	QVector<ProfileEvent> events;
+};
+
+//Scoped stage timers of the load and render paths, the last historySize frames are kept
+//thread safe: the render thread records stages, the GUI thread the blit and the export
+class Profiler {
+public:
+	Profiler() { clock.start(); }
+	qint64 now() const { return clock.nsecsElapsed(); }
+	static int threadIndex();
+
+	void record(const char* name, qint64 startNs, qint64 endNs);
+	void beginFrame();
+	//abandoned frame: the stages it recorded are dropped, not charged to the next frame
+	void cancelFrame();
+	void endFrame(qint64 polygons, qint64 pixels, qint64 allocations = 0, qint64 arenaBytes = 0);
+	//allocations made after endFrame (the overlay), added to the last frame
+	void addAllocations(qint64 allocations);
+	FrameProfile lastFrame() const;
+
+	void setHistorySize(int frames);
+	int getHistorySize() const { return historySize; }
+	//Chrome about:tracing JSON (also opens in Perfetto), one complete event per scope and frame
+	bool writeChromeTrace(const QString& path) const;
+
+private:
+	QElapsedTimer clock;
+	mutable std::mutex mutex;
+	QVector<ProfileEvent> pending;     //oldest dropped past maxPending, blits go on while no frame finishes
+	static const int maxPending = 4096;
+	qint64 frameStart = 0;
+	int frameThread = 0;
+	int frameCount = 0;
+	QVector<FrameProfile> frames;   //oldest first
+	int historySize = 120;
+};
+
+//times its own lifetime
+class ProfileScope {
+public:
+	ProfileScope(Profiler& profiler, const char* name) : profiler(profiler), name(name), start(profiler.now()) {}
+	~ProfileScope() { profiler.record(name, start, profiler.now()); }
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	Profiler& profiler;
+	const char* name;
+	qint64 start;
+};
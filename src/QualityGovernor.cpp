@@ -0,0 +1,26 @@
+#include "QualityGovernor.h"
+
+//each step roughly halves the frame cost
+const QualityLevel QualityGovernor::levels[levelCount] = {
+	{ 1, 1 },
+	{ 2, 1 },
+	{ 2, 2 },
+	{ 4, 2 },
+	{ 4, 4 },
+};
+
+void QualityGovernor::frameRendered(double ms)
+{
+	//finer only with room for the next level's cost, no flip-flopping around the budget
+	if (ms > budgetMs && level + 1 < levelCount)
+		level++;
+	else if (ms < budgetMs * 0.4 && level > 0)
+		level--;
+}
+
+void QualityGovernor::frameAbandoned(double ms)
+{
+	//under budget it was cut short by newer input, the cost is unknown
+	if (ms > budgetMs && level + 1 < levelCount)
+		level++;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+//preview quality, gridStep cells merged per side, image rendered at 1 / resolutionDivisor and scaled up
+struct QualityLevel {
+	int gridStep;
+	int resolutionDivisor;
+	bool isFull() const { return gridStep == 1 && resolutionDivisor == 1; }
+};
+
+//Frame time budget for interactive frames (rotation, zoom)
+//over budget -> one level coarser, well under -> one level finer, the level carries over to the next drag
+//after idleDelay ms without input the caller renders a full quality frame
+class QualityGovernor {
+public:
+	static const int levelCount = 5;
+	static const QualityLevel levels[levelCount];
+
+	void setBudget(double ms) { budgetMs = ms; }
+	double getBudget() const { return budgetMs; }
+	void setIdleDelay(int ms) { idleDelayMs = ms; }
+	int getIdleDelay() const { return idleDelayMs; }
+
+	QualityLevel current() const { return levels[level]; }
+	int currentLevel() const { return level; }
+	//completed interactive frames
+	void frameRendered(double ms);
+	//interactive frame cancelled after ms; past the budget it was too slow whatever was left, one level coarser
+	void frameAbandoned(double ms);
+
+private:
+	double budgetMs = 33.0;     //~30 FPS
+	int idleDelayMs = 250;
+	int level = 0;
+};
@@ -0,0 +1,303 @@
+#include "Rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(DEM_SIMD_X86)
+#include <emmintrin.h>
+#endif
+
+Rasterizer::Rasterizer()
+{
+	setSimd(true);
+}
+
+void Rasterizer::setSimd(bool enabled)
+{
+	static const bool avx2 = cpuHasAvx2();
+	simd = enabled;
+	kernel = fillTriangleScalar;
+#if defined(DEM_SIMD_X86)
+	if (enabled)
+		kernel = avx2 ? fillTriangleAvx2 : fillTriangleSse;
+#endif
+}
+
+void Rasterizer::setTarget(QImage* image)
+{
+	target = image;
+	int w = image ? image->width() : 0;
+	int h = image ? image->height() : 0;
+	//front / back buffers of one size share depth and bins
+	if (w == width && h == height && !depth.empty()) return;
+	width = w;
+	height = h;
+	depth.resize(size_t(width) * height);
+	clearDepth();
+
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+	bins.assign(size_t(tilesX) * tilesY, std::vector<int>());
+	queue.clear();
+}
+
+void Rasterizer::clearDepth()
+{
+	std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+}
+
+void Rasterizer::beginFrame()
+{
+	clearDepth();
+	queue.clear();
+	trianglesSubmitted = 0;
+	pixelsWritten = 0;
+}
+
+void Rasterizer::fillTriangle(const QVector3D& a, const QVector3D& b, const QVector3D& c, QRgb color)
+{
+	submit({ a, b, c, { color, color, color }, false });
+}
+
+void Rasterizer::fillTriangle(const QVector3D& a, const QVector3D& b, const QVector3D& c, QRgb colorA, QRgb colorB, QRgb colorC)
+{
+	submit({ a, b, c, { colorA, colorB, colorC }, true });
+}
+
+void Rasterizer::submit(const RasterTriangle& tri)
+{
+	if (target == nullptr) return;
+
+	trianglesSubmitted++;
+	if (binned) {
+		queue.push_back(tri);
+		//batches keep the submission order, the image is the same as one flush at the end
+		if (int(queue.size()) >= batchSize)
+			flush();
+	}
+	else
+		pixelsWritten += rasterize(tri, 0, 0, width - 1, height - 1);
+}
+
+void Rasterizer::flush()
+{
+	if (queue.empty()) return;
+	if (cancelFlag && cancelFlag->load(std::memory_order_relaxed)) {
+		queue.clear();
+		return;
+	}
+
+	//binning, keeps submission order inside every tile
+	for (std::vector<int>& bin : bins)
+		bin.clear();
+
+	for (int i = 0; i < int(queue.size()); ++i) {
+		const RasterTriangle& t = queue[i];
+		float minX = std::min({ t.a.x(), t.b.x(), t.c.x() });
+		float maxX = std::max({ t.a.x(), t.b.x(), t.c.x() });
+		float minY = std::min({ t.a.y(), t.b.y(), t.c.y() });
+		float maxY = std::max({ t.a.y(), t.b.y(), t.c.y() });
+		if (maxX < 0 || maxY < 0 || minX > width - 1 || minY > height - 1) continue;
+
+		int tx0 = std::max(0, int(std::ceil(minX)) / tileSize);
+		int tx1 = std::min(tilesX - 1, int(std::floor(maxX)) / tileSize);
+		int ty0 = std::max(0, int(std::ceil(minY)) / tileSize);
+		int ty1 = std::min(tilesY - 1, int(std::floor(maxY)) / tileSize);
+		for (int ty = ty0; ty <= ty1; ++ty)
+			for (int tx = tx0; tx <= tx1; ++tx)
+				bins[size_t(ty) * tilesX + tx].push_back(i);
+	}
+
+	//tiles are disjoint -> no locking, dynamic schedule balances busy tiles
+	int tileCount = tilesX * tilesY;
+	qint64 written = 0;
+	#pragma omp parallel for schedule(dynamic) reduction(+:written)
+	for (int tile = 0; tile < tileCount; ++tile) {
+		int x0 = (tile % tilesX) * tileSize;
+		int y0 = (tile / tilesX) * tileSize;
+		int x1 = std::min(x0 + tileSize, width) - 1;
+		int y1 = std::min(y0 + tileSize, height) - 1;
+		if (cancelFlag && cancelFlag->load(std::memory_order_relaxed)) continue;
+		for (int index : bins[tile])
+			written += rasterize(queue[index], x0, y0, x1, y1);
+	}
+	pixelsWritten += written;
+
+	queue.clear();
+}
+
+//fill rule: pixels exactly on an edge belong to top and left edges only
+static inline bool isTopLeft(float dx, float dy)
+{
+	return dy < 0 || (dy == 0 && dx > 0);
+}
+
+int Rasterizer::rasterize(const RasterTriangle& tri, int clipX0, int clipY0, int clipX1, int clipY1)
+{
+	//edge functions positive inside
+	QVector3D a = tri.a, b = tri.b, c = tri.c;
+	QRgb colorB = tri.color[1], colorC = tri.color[2];
+	float area = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+	if (area == 0) return 0;
+	if (area < 0) {
+		std::swap(b, c);
+		std::swap(colorB, colorC);
+		area = -area;
+	}
+
+	TriangleFillJob job;
+	job.minX = std::max(clipX0, int(std::ceil(std::min({ a.x(), b.x(), c.x() }))));
+	job.maxX = std::min(clipX1, int(std::floor(std::max({ a.x(), b.x(), c.x() }))));
+	job.minY = std::max(clipY0, int(std::ceil(std::min({ a.y(), b.y(), c.y() }))));
+	job.maxY = std::min(clipY1, int(std::floor(std::max({ a.y(), b.y(), c.y() }))));
+	if (job.minX > job.maxX || job.minY > job.maxY) return 0;
+
+	//w0 opposite a (edge b->c), w1 opposite b (c->a), w2 opposite c (a->b)
+	const QVector3D* origin[3] = { &b, &c, &a };
+	const QVector3D* end[3] = { &c, &a, &b };
+	for (int i = 0; i < 3; ++i) {
+		job.originX[i] = origin[i]->x();
+		job.originY[i] = origin[i]->y();
+		job.dx[i] = end[i]->x() - origin[i]->x();
+		job.dy[i] = end[i]->y() - origin[i]->y();
+		job.topLeft[i] = isTopLeft(job.dx[i], job.dy[i]);
+	}
+	job.z[0] = a.z();
+	job.z[1] = b.z();
+	job.z[2] = c.z();
+	job.invArea = 1.0f / area;
+
+	job.color = reinterpret_cast<unsigned int*>(target->bits());
+	job.colorStride = target->bytesPerLine() / 4;
+	job.depth = depth.data();
+	job.depthStride = width;
+	job.rgb[0] = tri.color[0];
+	job.rgb[1] = colorB;
+	job.rgb[2] = colorC;
+	job.smooth = tri.smooth;
+
+	return kernel(job);
+}
+
+static inline unsigned int interpolateColor(const TriangleFillJob& t, float w0, float w1, float w2)
+{
+	int r = int((w0 * qRed(t.rgb[0]) + w1 * qRed(t.rgb[1]) + w2 * qRed(t.rgb[2])) * t.invArea);
+	int g = int((w0 * qGreen(t.rgb[0]) + w1 * qGreen(t.rgb[1]) + w2 * qGreen(t.rgb[2])) * t.invArea);
+	int b = int((w0 * qBlue(t.rgb[0]) + w1 * qBlue(t.rgb[1]) + w2 * qBlue(t.rgb[2])) * t.invArea);
+	return (t.rgb[0] & 0xff000000) | (r << 16) | (g << 8) | b;
+}
+
+static inline int fillPixel(const TriangleFillJob& t, const float row[3], int x, unsigned int* line, float* zLine)
+{
+	//evaluated per pixel, not accumulated: the result must not depend on the clip rect
+	float w0 = row[0] - t.dy[0] * (x - t.originX[0]);
+	float w1 = row[1] - t.dy[1] * (x - t.originX[1]);
+	float w2 = row[2] - t.dy[2] * (x - t.originX[2]);
+	if ((w0 > 0 || (w0 == 0 && t.topLeft[0])) && (w1 > 0 || (w1 == 0 && t.topLeft[1])) && (w2 > 0 || (w2 == 0 && t.topLeft[2]))) {
+		//barycentric depth
+		float z = (w0 * t.z[0] + w1 * t.z[1] + w2 * t.z[2]) * t.invArea;
+		if (z < zLine[x]) {
+			zLine[x] = z;
+			line[x] = t.smooth ? interpolateColor(t, w0, w1, w2) : t.rgb[0];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int fillTriangleScalar(const TriangleFillJob& t)
+{
+	int written = 0;
+	for (int y = t.minY; y <= t.maxY; ++y) {
+		float row[3];
+		for (int i = 0; i < 3; ++i)
+			row[i] = t.dx[i] * (y - t.originY[i]);
+		unsigned int* line = t.color + y * t.colorStride;
+		float* zLine = t.depth + y * t.depthStride;
+
+		for (int x = t.minX; x <= t.maxX; ++x)
+			written += fillPixel(t, row, x, line, zLine);
+	}
+	return written;
+}
+
+#if defined(DEM_SIMD_X86)
+
+//4 pixels per step, blended with and/andnot, scalar tail
+int fillTriangleSse(const TriangleFillJob& t)
+{
+	int written = 0;
+	const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 ox0 = _mm_set1_ps(t.originX[0]), ox1 = _mm_set1_ps(t.originX[1]), ox2 = _mm_set1_ps(t.originX[2]);
+	const __m128 dy0 = _mm_set1_ps(t.dy[0]), dy1 = _mm_set1_ps(t.dy[1]), dy2 = _mm_set1_ps(t.dy[2]);
+	const __m128 tl0 = _mm_castsi128_ps(_mm_set1_epi32(t.topLeft[0] ? -1 : 0));
+	const __m128 tl1 = _mm_castsi128_ps(_mm_set1_epi32(t.topLeft[1] ? -1 : 0));
+	const __m128 tl2 = _mm_castsi128_ps(_mm_set1_epi32(t.topLeft[2] ? -1 : 0));
+	const __m128 z0 = _mm_set1_ps(t.z[0]), z1 = _mm_set1_ps(t.z[1]), z2 = _mm_set1_ps(t.z[2]);
+	const __m128 invArea = _mm_set1_ps(t.invArea);
+	const __m128i color = _mm_set1_epi32(int(t.rgb[0]));
+	const __m128i alpha = _mm_set1_epi32(int(t.rgb[0] & 0xff000000));
+	__m128 channel[3][3];   //[r, g, b][vertex]
+	for (int v = 0; v < 3; ++v) {
+		channel[0][v] = _mm_set1_ps(float(qRed(t.rgb[v])));
+		channel[1][v] = _mm_set1_ps(float(qGreen(t.rgb[v])));
+		channel[2][v] = _mm_set1_ps(float(qBlue(t.rgb[v])));
+	}
+
+	for (int y = t.minY; y <= t.maxY; ++y) {
+		float row[3];
+		for (int i = 0; i < 3; ++i)
+			row[i] = t.dx[i] * (y - t.originY[i]);
+		const __m128 row0 = _mm_set1_ps(row[0]), row1 = _mm_set1_ps(row[1]), row2 = _mm_set1_ps(row[2]);
+		unsigned int* line = t.color + y * t.colorStride;
+		float* zLine = t.depth + y * t.depthStride;
+
+		int x = t.minX;
+		for (; x + 3 <= t.maxX; x += 4) {
+			__m128 xv = _mm_add_ps(_mm_set1_ps(float(x)), lane);
+			__m128 w0 = _mm_sub_ps(row0, _mm_mul_ps(dy0, _mm_sub_ps(xv, ox0)));
+			__m128 w1 = _mm_sub_ps(row1, _mm_mul_ps(dy1, _mm_sub_ps(xv, ox1)));
+			__m128 w2 = _mm_sub_ps(row2, _mm_mul_ps(dy2, _mm_sub_ps(xv, ox2)));
+
+			__m128 in0 = _mm_or_ps(_mm_cmpgt_ps(w0, zero), _mm_and_ps(_mm_cmpeq_ps(w0, zero), tl0));
+			__m128 in1 = _mm_or_ps(_mm_cmpgt_ps(w1, zero), _mm_and_ps(_mm_cmpeq_ps(w1, zero), tl1));
+			__m128 in2 = _mm_or_ps(_mm_cmpgt_ps(w2, zero), _mm_and_ps(_mm_cmpeq_ps(w2, zero), tl2));
+			__m128 mask = _mm_and_ps(_mm_and_ps(in0, in1), in2);
+			if (_mm_movemask_ps(mask) == 0)
+				continue;
+
+			__m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, z0), _mm_mul_ps(w1, z1)), _mm_mul_ps(w2, z2)), invArea);
+			__m128 old = _mm_loadu_ps(zLine + x);
+			mask = _mm_and_ps(mask, _mm_cmplt_ps(z, old));
+			written += countMaskBits(_mm_movemask_ps(mask));
+			_mm_storeu_ps(zLine + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old)));
+
+			__m128i write = _mm_castps_si128(mask);
+			__m128i pixel = color;
+			if (t.smooth) {
+				__m128i rgb[3];
+				for (int k = 0; k < 3; ++k) {
+					__m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, channel[k][0]), _mm_mul_ps(w1, channel[k][1])), _mm_mul_ps(w2, channel[k][2]));
+					rgb[k] = _mm_cvttps_epi32(_mm_mul_ps(v, invArea));
+				}
+				pixel = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(rgb[0], 16)), _mm_or_si128(_mm_slli_epi32(rgb[1], 8), rgb[2]));
+			}
+			__m128i* pixels = reinterpret_cast<__m128i*>(line + x);
+			__m128i oldColor = _mm_loadu_si128(pixels);
+			_mm_storeu_si128(pixels, _mm_or_si128(_mm_and_si128(write, pixel), _mm_andnot_si128(write, oldColor)));
+		}
+		for (; x <= t.maxX; ++x)
+			written += fillPixel(t, row, x, line, zLine);
+	}
+	return written;
+}
+
+#else
+
+int fillTriangleSse(const TriangleFillJob& t)
+{
+	return fillTriangleScalar(t);
+}
+
+#endif
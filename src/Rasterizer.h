@@ -0,0 +1,67 @@
+#pragma once
+#include <QImage>
+#include <QVector3D>
+#include <vector>
+#include <atomic>
+#include "SimdKernels.h"
+
+struct RasterTriangle {
+	QVector3D a, b, c;      //(screen x, screen y, depth)
+	QRgb color[3];          //per vertex, interpolated when smooth
+	bool smooth;
+};
+
+//Depth tested triangle fill into an ARGB32 image
+//vertices are (screen x, screen y, depth), smaller depth = nearer
+//binned mode: triangles are queued, sorted into screen tiles on flush() and
+//the tiles are filled in parallel, each thread owning whole tiles of color + depth;
+//a full queue (batchSize) is flushed on submit, memory stays bounded whatever the mesh size
+//pixels are tested 8 (AVX2) or 4 (SSE2) at a time, setSimd(false) keeps the scalar loop for comparison
+class Rasterizer {
+public:
+	Rasterizer();
+	static const int tileSize = 64;
+	static const int batchSize = 1 << 16;   //queued triangles, ~3.4 MB
+
+	void setTarget(QImage* image);
+	void clearDepth();
+
+	void beginFrame();
+	void fillTriangle(const QVector3D& a, const QVector3D& b, const QVector3D& c, QRgb color);
+	//Gouraud: vertex colors interpolated across the triangle
+	void fillTriangle(const QVector3D& a, const QVector3D& b, const QVector3D& c, QRgb colorA, QRgb colorB, QRgb colorC);
+	void flush();
+
+	void setBinned(bool enabled) { binned = enabled; }
+	bool isBinned() const { return binned; }
+	void setSimd(bool enabled);
+	bool isSimd() const { return simd; }
+	//set -> flush() skips the remaining tiles
+	void setCancelFlag(const std::atomic<bool>* flag) { cancelFlag = flag; }
+
+	const std::vector<float>& getDepth() const { return depth; }
+	//since beginFrame(), pixels = depth test passes
+	qint64 getTrianglesSubmitted() const { return trianglesSubmitted; }
+	qint64 getPixelsWritten() const { return pixelsWritten; }
+
+private:
+	void submit(const RasterTriangle& tri);
+	int rasterize(const RasterTriangle& tri, int clipX0, int clipY0, int clipX1, int clipY1);
+
+	typedef int (*FillKernel)(const TriangleFillJob&);
+	FillKernel kernel = fillTriangleScalar;
+	bool simd = true;
+
+	const std::atomic<bool>* cancelFlag = nullptr;
+
+	QImage* target = nullptr;
+	int width = 0, height = 0;
+	std::vector<float> depth;   //kept between frames, resized only with the image
+
+	qint64 trianglesSubmitted = 0, pixelsWritten = 0;
+
+	bool binned = true;
+	int tilesX = 0, tilesY = 0;
+	std::vector<RasterTriangle> queue;
+	std::vector<std::vector<int>> bins;     //triangle indices per tile, in submission order
+};
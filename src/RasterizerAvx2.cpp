@@ -0,0 +1,78 @@
+#include "SimdKernels.h"
+
+#if defined(DEM_SIMD_X86)
+#include <immintrin.h>
+
+//8 pixels per step, the row tail is handled with masked loads/stores
+int fillTriangleAvx2(const TriangleFillJob& t)
+{
+	int written = 0;
+	const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 lastX = _mm256_set1_ps(float(t.maxX));
+	const __m256 ox0 = _mm256_set1_ps(t.originX[0]), ox1 = _mm256_set1_ps(t.originX[1]), ox2 = _mm256_set1_ps(t.originX[2]);
+	const __m256 dy0 = _mm256_set1_ps(t.dy[0]), dy1 = _mm256_set1_ps(t.dy[1]), dy2 = _mm256_set1_ps(t.dy[2]);
+	const __m256 tl0 = _mm256_castsi256_ps(_mm256_set1_epi32(t.topLeft[0] ? -1 : 0));
+	const __m256 tl1 = _mm256_castsi256_ps(_mm256_set1_epi32(t.topLeft[1] ? -1 : 0));
+	const __m256 tl2 = _mm256_castsi256_ps(_mm256_set1_epi32(t.topLeft[2] ? -1 : 0));
+	const __m256 z0 = _mm256_set1_ps(t.z[0]), z1 = _mm256_set1_ps(t.z[1]), z2 = _mm256_set1_ps(t.z[2]);
+	const __m256 invArea = _mm256_set1_ps(t.invArea);
+	const __m256i color = _mm256_set1_epi32(int(t.rgb[0]));
+	const __m256i alpha = _mm256_set1_epi32(int(t.rgb[0] & 0xff000000));
+	__m256 channel[3][3];   //[r, g, b][vertex]
+	for (int v = 0; v < 3; ++v) {
+		channel[0][v] = _mm256_set1_ps(float((t.rgb[v] >> 16) & 0xff));
+		channel[1][v] = _mm256_set1_ps(float((t.rgb[v] >> 8) & 0xff));
+		channel[2][v] = _mm256_set1_ps(float(t.rgb[v] & 0xff));
+	}
+
+	for (int y = t.minY; y <= t.maxY; ++y) {
+		const __m256 row0 = _mm256_set1_ps(t.dx[0] * (y - t.originY[0]));
+		const __m256 row1 = _mm256_set1_ps(t.dx[1] * (y - t.originY[1]));
+		const __m256 row2 = _mm256_set1_ps(t.dx[2] * (y - t.originY[2]));
+		unsigned int* line = t.color + y * t.colorStride;
+		float* zLine = t.depth + y * t.depthStride;
+
+		for (int x = t.minX; x <= t.maxX; x += 8) {
+			__m256 xv = _mm256_add_ps(_mm256_set1_ps(float(x)), lane);
+			__m256 w0 = _mm256_sub_ps(row0, _mm256_mul_ps(dy0, _mm256_sub_ps(xv, ox0)));
+			__m256 w1 = _mm256_sub_ps(row1, _mm256_mul_ps(dy1, _mm256_sub_ps(xv, ox1)));
+			__m256 w2 = _mm256_sub_ps(row2, _mm256_mul_ps(dy2, _mm256_sub_ps(xv, ox2)));
+
+			__m256 in0 = _mm256_or_ps(_mm256_cmp_ps(w0, zero, _CMP_GT_OQ), _mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_EQ_OQ), tl0));
+			__m256 in1 = _mm256_or_ps(_mm256_cmp_ps(w1, zero, _CMP_GT_OQ), _mm256_and_ps(_mm256_cmp_ps(w1, zero, _CMP_EQ_OQ), tl1));
+			__m256 in2 = _mm256_or_ps(_mm256_cmp_ps(w2, zero, _CMP_GT_OQ), _mm256_and_ps(_mm256_cmp_ps(w2, zero, _CMP_EQ_OQ), tl2));
+			__m256 inRow = _mm256_cmp_ps(xv, lastX, _CMP_LE_OQ);
+			__m256 mask = _mm256_and_ps(_mm256_and_ps(in0, in1), _mm256_and_ps(in2, inRow));
+			if (_mm256_movemask_ps(mask) == 0)
+				continue;
+
+			__m256 z = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w0, z0), _mm256_mul_ps(w1, z1)), _mm256_mul_ps(w2, z2)), invArea);
+			__m256 old = _mm256_maskload_ps(zLine + x, _mm256_castps_si256(inRow));
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+			written += countMaskBits(_mm256_movemask_ps(mask));
+			__m256i write = _mm256_castps_si256(mask);
+			__m256i pixel = color;
+			if (t.smooth) {
+				__m256i rgb[3];
+				for (int k = 0; k < 3; ++k) {
+					__m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w0, channel[k][0]), _mm256_mul_ps(w1, channel[k][1])), _mm256_mul_ps(w2, channel[k][2]));
+					rgb[k] = _mm256_cvttps_epi32(_mm256_mul_ps(v, invArea));
+				}
+				pixel = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(rgb[0], 16)), _mm256_or_si256(_mm256_slli_epi32(rgb[1], 8), rgb[2]));
+			}
+			_mm256_maskstore_ps(zLine + x, write, z);
+			_mm256_maskstore_epi32(reinterpret_cast<int*>(line + x), write, pixel);
+		}
+	}
+	return written;
+}
+
+#else
+
+int fillTriangleAvx2(const TriangleFillJob& t)
+{
+	return fillTriangleScalar(t);
+}
+
+#endif
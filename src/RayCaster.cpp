@@ -0,0 +1,174 @@
+#include "RayCaster.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+void RayCaster::clear()
+{
+	heights = nullptr;
+	cellsX = cellsY = 0;
+	levels.clear();
+}
+
+void RayCaster::build(const GridInfo& grid, const float* heights)
+{
+	clear();
+	if (heights == nullptr || !grid.isValid()) return;
+	this->grid = grid;
+	this->heights = heights;
+	cellsX = grid.cols - 1;
+	cellsY = grid.rows - 1;
+
+	//level 1 straight from the samples (a 2 x 2 cell block covers 3 x 3 of them), then 2 x 2 blocks of the level below
+	for (int size = 2; ; size *= 2) {
+		HeightLevel level;
+		level.cols = (cellsX + size - 1) / size;
+		level.rows = (cellsY + size - 1) / size;
+		level.minZ.resize(level.cols * level.rows);
+		level.maxZ.resize(level.cols * level.rows);
+		const HeightLevel* below = levels.isEmpty() ? nullptr : &levels.last();
+
+		#pragma omp parallel for schedule(static)
+		for (int y = 0; y < level.rows; ++y) {
+			for (int x = 0; x < level.cols; ++x) {
+				float lo = std::numeric_limits<float>::max(), hi = -lo;
+				if (below == nullptr) {
+					for (int r = 2 * y; r <= std::min(2 * y + 2, grid.rows - 1); ++r)
+						for (int c = 2 * x; c <= std::min(2 * x + 2, grid.cols - 1); ++c) {
+							lo = std::min(lo, height(r, c));
+							hi = std::max(hi, height(r, c));
+						}
+				}
+				else {
+					for (int by = 2 * y; by < std::min(2 * y + 2, below->rows); ++by)
+						for (int bx = 2 * x; bx < std::min(2 * x + 2, below->cols); ++bx) {
+							lo = std::min(lo, below->minZ[by * below->cols + bx]);
+							hi = std::max(hi, below->maxZ[by * below->cols + bx]);
+						}
+				}
+				level.minZ[y * level.cols + x] = lo;
+				level.maxZ[y * level.cols + x] = hi;
+			}
+		}
+		levels.append(level);
+		if (level.cols == 1 && level.rows == 1) break;
+	}
+}
+
+void RayCaster::nodeRange(int level, int x, int y, float& minZ, float& maxZ) const
+{
+	if (level == 0) {
+		float h[4] = { height(y, x), height(y, x + 1), height(y + 1, x), height(y + 1, x + 1) };
+		minZ = *std::min_element(h, h + 4);
+		maxZ = *std::max_element(h, h + 4);
+		return;
+	}
+	const HeightLevel& info = levels[level - 1];
+	minZ = info.minZ[y * info.cols + x];
+	maxZ = info.maxZ[y * info.cols + x];
+}
+
+bool RayCaster::intersectCell(int cx, int cy, const QVector3D& origin, const QVector3D& dir, double t0, double t1, float& t) const
+{
+	float h00 = height(cy, cx), h10 = height(cy, cx + 1), h01 = height(cy + 1, cx), h11 = height(cy + 1, cx + 1);
+	//ray height above the bilinear patch
+	auto above = [&](double s) {
+		double u = std::clamp(origin.x() + dir.x() * s - cx, 0.0, 1.0);
+		double v = std::clamp(origin.y() + dir.y() * s - cy, 0.0, 1.0);
+		double h = (h00 * (1 - u) + h10 * u) * (1 - v) + (h01 * (1 - u) + h11 * u) * v;
+		return origin.z() + dir.z() * s - h;
+	};
+
+	double f0 = above(t0), fm = above(0.5 * (t0 + t1)), f1 = above(t1);
+	if (f0 <= 0) {
+		t = t0;
+		return true;
+	}
+
+	//along a straight ray the difference is quadratic, three samples give it exactly; s in [0, 1] over the cell
+	double a = 2 * f0 - 4 * fm + 2 * f1, b = -3 * f0 + 4 * fm - f1, c = f0;
+	double s = -1;
+	if (std::abs(a) < 1e-12) {
+		if (b < 0) s = -c / b;
+	}
+	else {
+		double disc = b * b - 4 * a * c;
+		if (disc >= 0) {
+			double q = std::sqrt(disc);
+			double s0 = (-b - q) / (2 * a), s1 = (-b + q) / (2 * a);
+			if (s0 > s1) std::swap(s0, s1);
+			s = s0 >= 0 ? s0 : s1;
+		}
+	}
+	if (s < 0 || s > 1) return false;
+	t = float(t0 + s * (t1 - t0));
+	return true;
+}
+
+bool RayCaster::intersect(const QVector3D& origin, const QVector3D& dir, float& t) const
+{
+	if (isEmpty()) return false;
+
+	//clip to the grid box, one slab per axis
+	const double lo[3] = { 0, 0, grid.minZ }, hi[3] = { double(cellsX), double(cellsY), grid.maxZ };
+	double tNear = -std::numeric_limits<double>::max(), tFar = std::numeric_limits<double>::max();
+	for (int i = 0; i < 3; ++i) {
+		if (std::abs(dir[i]) < 1e-12f) {
+			if (origin[i] < lo[i] || origin[i] > hi[i]) return false;
+			continue;
+		}
+		double a = (lo[i] - origin[i]) / dir[i], b = (hi[i] - origin[i]) / dir[i];
+		tNear = std::max(tNear, std::min(a, b));
+		tFar = std::min(tFar, std::max(a, b));
+	}
+	if (tNear > tFar) return false;
+
+	//doubles: t stepped past a node border must still land in the next cell on large grids
+	const double ox = origin.x(), oy = origin.y(), oz = origin.z();
+	const double dx = dir.x(), dy = dir.y(), dz = dir.z();
+	double stepXY = std::max(std::abs(dx), std::abs(dy));
+	const double eps = stepXY > 0 ? 1e-6 / stepXY : 0;
+
+	const int top = levels.size();
+	int level = top;
+	double tCur = tNear;
+	//every cell is entered at most once per level
+	const qint64 maxIterations = 4 * (qint64(cellsX) + cellsY) * (top + 1) + 64;
+	for (qint64 iteration = 0; iteration < maxIterations; ++iteration) {
+		int cx = std::clamp(int(std::floor(ox + dx * tCur)), 0, cellsX - 1);
+		int cy = std::clamp(int(std::floor(oy + dy * tCur)), 0, cellsY - 1);
+		int x = cx >> level, y = cy >> level;
+		int size = 1 << level;
+
+		//where the ray leaves the node's column
+		double tExit = tFar;
+		if (dx > 0) tExit = std::min(tExit, (std::min((x + 1) * size, cellsX) - ox) / dx);
+		else if (dx < 0) tExit = std::min(tExit, (x * size - ox) / dx);
+		if (dy > 0) tExit = std::min(tExit, (std::min((y + 1) * size, cellsY) - oy) / dy);
+		else if (dy < 0) tExit = std::min(tExit, (y * size - oy) / dy);
+		tExit = std::max(tExit, tCur);
+
+		float minZ, maxZ;
+		nodeRange(level, x, y, minZ, maxZ);
+		double zEnter = oz + dz * tCur, zExit = oz + dz * tExit;
+
+		bool skip = std::min(zEnter, zExit) > maxZ;
+		if (!skip && level > 0) {
+			//already below every sample of the node: the surface was crossed at its border
+			if (zEnter <= minZ) {
+				t = float(tCur);
+				return true;
+			}
+			level--;
+			continue;
+		}
+		if (!skip && intersectCell(cx, cy, origin, dir, tCur, tExit, t))
+			return true;
+
+		//past the node, one level up for the next one
+		if (tExit >= tFar) return false;
+		tCur = tExit + eps;
+		level = std::min(level + 1, top);
+	}
+	return false;
+}
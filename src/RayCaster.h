@@ -0,0 +1,35 @@
+#pragma once
+#include <QVector>
+#include <QVector3D>
+#include "Grid.h"
+
+//min / max heights of 2^level x 2^level cell blocks, level 1 = 2 x 2 cells
+//level 0 (single cells) is read from the heights
+struct HeightLevel {
+	int cols, rows;             //blocks
+	QVector<float> minZ, maxZ;
+};
+
+//Ray / height field intersection over a min-max mipmap
+//rays are in grid space: x = column, y = row, z = height; a cell spans [c, c+1] x [r, r+1], bilinear inside
+//above a block's max the ray skips the whole block, the traversal climbs after every skip
+class RayCaster {
+public:
+	void build(const GridInfo& grid, const float* heights);
+	void clear();
+	bool isEmpty() const { return heights == nullptr; }
+
+	//first hit of origin + t * dir with the surface, t = ray parameter of the hit
+	bool intersect(const QVector3D& origin, const QVector3D& dir, float& t) const;
+	int levelCount() const { return levels.size() + 1; }
+
+private:
+	float height(int r, int c) const { return heights[qint64(r) * grid.cols + c]; }
+	void nodeRange(int level, int x, int y, float& minZ, float& maxZ) const;
+	bool intersectCell(int cx, int cy, const QVector3D& origin, const QVector3D& dir, double t0, double t1, float& t) const;
+
+	GridInfo grid;
+	const float* heights = nullptr;
+	int cellsX = 0, cellsY = 0;
+	QVector<HeightLevel> levels;        //levels[i] = level i + 1
+};
@@ -0,0 +1,1243 @@
+#include "Renderer.h"
+#include "XyzParser.h"
+#include "GridReader.h"
+#include "VertexTransform.h"
+#include "AllocationCounter.h"
+#include <QPainter>
+#include <QMap>
+
+Renderer::Renderer()
+{
+	//abandoned frames also skip the binned tiles
+	rasterizer.setCancelFlag(&cancelled);
+}
+
+void Renderer::invalidate(int stages)
+{
+	//downstream stages follow
+	if (stages & StageNormals)
+		stages |= StageColors;
+	if (stages & (StageColors | StageGeometry))
+		stages |= StageFrame;
+	dirtyStages |= stages;
+}
+
+bool Renderer::render(QImage& image)
+{
+	//a new size moves the fit
+	if (image.size() != frameSize) {
+		frameSize = image.size();
+		invalidate(StageGeometry);
+	}
+	target = &image;
+	rasterizer.setTarget(target);
+
+	//nothing changed since the last frame, the image is still valid
+	if (dirtyStages == 0) return false;
+	profiler.beginFrame();
+	polygonsDrawn = 0;
+	arena.reset();
+	qint64 allocationsBefore = AllocationCounter::count();
+
+	const GridInfo& grid = model.getGrid();
+	if ((dirtyStages & StageNormals) && !tiledRendering) {
+		ProfileScope scope(profiler, "normals");
+		model.computeNormals();
+	}
+
+	if (dirtyStages & StageGeometry) {
+		frameMatrix = camera.viewMatrix() * model.modelMatrix();
+		frameOffset = camera.viewMatrix().mapVector(model.getModelTranslation());
+	}
+
+	if (dirtyStages & StageColors) {
+		//directional light for vertex shading, from the grid center
+		QVector3D gridCenter(grid.xAt(grid.cols / 2), grid.yAt(grid.rows / 2), (grid.minZ + grid.maxZ) / 2.0f);
+		lightDir = (camera.getLightPosition() - gridCenter).normalized();
+	}
+
+	//frame stage, the mesh paths reuse their cached stages
+	{
+		ProfileScope scope(profiler, "clear");
+		image.fill(Qt::white);
+		rasterizer.beginFrame();
+	}
+
+	if (renderMode >= ModeHillshade)
+		showRaster();
+	else if (renderMode == ModeRaycast)
+		showRaycast();
+	else if (tiledRendering)
+		showModelTiled();
+	else if (lodTolerance > 0 && !lod.isEmpty())
+		showModelLod();
+	else
+		showModelFull();
+
+	//binned triangles are filled here, tiles in parallel
+	{
+		ProfileScope scope(profiler, "fill");
+		rasterizer.flush();
+	}
+
+	//abandoned: the stages stay dirty and run again with the newer parameters
+	if (isCancelled()) {
+		profiler.cancelFrame();
+		return false;
+	}
+	dirtyStages = 0;
+	//pixels = depth test passes, the scanline fill path does not count them
+	//heap allocations of the counted threads (render, OpenMP workers) while the frame rendered, the overlay's own are added after it
+	qint64 allocations = AllocationCounter::available() ? AllocationCounter::count() - allocationsBefore : -1;
+	profiler.endFrame(polygonsDrawn, rasterizer.getPixelsWritten(), allocations, arena.stats().peakBytes);
+	if (showHud) {
+		qint64 hudBefore = AllocationCounter::count();
+		drawHud();
+		if (AllocationCounter::available())
+			profiler.addAllocations(AllocationCounter::count() - hudBefore);
+	}
+	return true;
+}
+
+void Renderer::drawHud()
+{
+	FrameProfile frame = profiler.lastFrame();
+
+	//stage sums in first-seen order, a stage may run more than once per frame
+	QStringList names;
+	QMap<QString, qint64> stageNs;
+	for (const ProfileEvent& event : frame.events) {
+		QString name(event.name);
+		if (!stageNs.contains(name))
+			names.append(name);
+		stageNs[name] += event.durationNs;
+	}
+
+	QStringList lines;
+	lines << QString("frame %1  %2 ms").arg(frame.index).arg(frame.durationNs / 1e6, 0, 'f', 2);
+	lines << QString("polygons %1  pixels %2").arg(frame.polygons).arg(frame.pixels);
+	//previews (quality governor): merged cells and the reduced image size
+	lines << QString("grid step %1  image %2 x %3").arg(gridStep).arg(target->width()).arg(target->height());
+	lines << QString("allocs %1  arena %2 KB").arg(frame.allocations >= 0 ? QString::number(frame.allocations) : QString("n/a")).arg(frame.arenaBytes / 1024);
+	if (tiledRendering && renderMode < ModeRaycast)
+		lines << QString("tiles level %1  cache %2 MB  hits %3  misses %4").arg(tileLevel)
+			.arg(tileCache.getUsed() / (1024 * 1024)).arg(tileCache.getHits()).arg(tileCache.getMisses());
+	for (const QString& name : names)
+		lines << QString("%1  %2 ms").arg(name, -10).arg(stageNs[name] / 1e6, 0, 'f', 2);
+
+	QPainter painter(target);
+	painter.setFont(QFont("Monospace", 9));
+	painter.setRenderHint(QPainter::TextAntialiasing);
+	QFontMetrics metrics = painter.fontMetrics();
+	int lineHeight = metrics.height();
+	int width = 0;
+	for (const QString& line : lines)
+		width = std::max(width, metrics.horizontalAdvance(line));
+
+	painter.fillRect(QRect(10, 10, width + 12, lineHeight * lines.size() + 8), QColor(0, 0, 0, 160));
+	painter.setPen(Qt::white);
+	for (int i = 0; i < lines.size(); ++i)
+		painter.drawText(16, 14 + metrics.ascent() + i * lineHeight, lines[i]);
+}
+
+void Renderer::showModelFull()
+{
+	if (model.isEmpty()) return;
+
+	const float margin = 20.0f;
+
+	const GridInfo& grid = model.getGrid();
+	const float* heights = model.getHeights();
+	const int cols = grid.cols;
+
+	//geometry stage: Transformujem a premietam points, whole height array in one batch
+	if (dirtyStages & StageGeometry) {
+		ProfileScope scope(profiler, "transform");
+		VertexTransform::transformGrid(frameMatrix, grid, heights, projected);
+
+		//Center and scale the model
+		ViewFit fit = fitBounds(projected.minX, projected.maxX, projected.minY, projected.maxY, margin);
+		VertexTransform::toScreen(projected, fit);
+		setupCulling(grid);
+	}
+
+	drawColorBar();
+
+	//color stage: lit vertex colors from the load-time normals
+	bool vertexShading = model.hasNormals();
+	if (vertexShading && (dirtyStages & StageColors)) {
+		ProfileScope scope(profiler, "shading");
+		vertexColors.resize(grid.vertexCount());
+		#pragma omp parallel for schedule(static)
+		for (int r = 0; r < grid.rows; ++r) {
+			qint64 row = qint64(r) * cols;
+			for (int c = 0; c < cols; ++c)
+				vertexColors[row + c] = shadeVertex(row + c, heights[row + c]);
+		}
+	}
+
+	//draw cells, corners idx, idx+1, idx+cols+1, idx+cols
+	//previews merge gridStep x gridStep cells, the last ones end on the border
+	const int step = gridStep;
+	if (!drawFilledPolygons) {
+		ProfileScope scope(profiler, "edges");
+		auto node = [&](int i, int j) { return qint64(std::min(j * step, grid.rows - 1)) * cols + std::min(i * step, cols - 1); };
+		auto screen = [&](int i, int j) { qint64 v = node(i, j); return QVector3D(projected.x[v], projected.y[v], projected.depth[v]); };
+		auto edgeColor = [&](int i0, int j0, int i1, int j1) {
+			qint64 a = node(i0, j0), b = node(i1, j1);
+			return vertexShading ? mixColors(vertexColors[a], vertexColors[b]) : colorLut.lookup(model.normalizeZ((heights[a] + heights[b]) / 2));
+		};
+		drawLatticeEdges((cols - 2) / step + 2, (grid.rows - 2) / step + 2, screen, edgeColor);
+		return;
+	}
+	ProfileScope scope(profiler, "cells");
+	QVector3D screenPoly[4];
+	for (int r = 0; r + 1 < grid.rows; r += step)
+	{
+		//newer parameters arrived, this frame is stale
+		if (isCancelled()) return;
+		qint64 row0 = qint64(r) * cols;
+		qint64 row1 = qint64(std::min(r + step, grid.rows - 1)) * cols;
+		for (int c = 0; c + 1 < cols; c += step)
+		{
+			int c1 = std::min(c + step, cols - 1);
+			qint64 idx = row0 + c;
+			qint64 quad[4] = { idx, row0 + c1, row1 + c1, row1 + c };
+
+			for (int i = 0; i < 4; ++i)
+				screenPoly[i] = QVector3D(projected.x[quad[i]], projected.y[quad[i]], projected.depth[quad[i]]);
+			//rejected before shading
+			if (!isCellVisible(screenPoly, 4))
+				continue;
+
+			if (vertexShading) {
+				QRgb colors[4];
+				for (int i = 0; i < 4; ++i)
+					colors[i] = vertexColors[quad[i]];
+				drawScreenPolygon(screenPoly, 4, colors);
+				continue;
+			}
+
+			QVector3D world[4];
+			for (int i = 0; i < 4; ++i)
+				world[i] = model.vertex(quad[i]);
+			QRgb litColor = shadePolygon(world, 4);
+
+			drawScreenPolygon(screenPoly, 4, litColor);
+		}
+	}
+}
+
+QRgb Renderer::shadeVertex(qint64 index, float z)
+{
+	float diffuse = std::clamp(QVector3D::dotProduct(model.normal(index), lightDir), 0.35f, 1.0f);
+	QRgb baseColor = colorLut.lookup(model.normalizeZ(z));
+	return qRgb(int(qRed(baseColor) * diffuse), int(qGreen(baseColor) * diffuse), int(qBlue(baseColor) * diffuse));
+}
+
+void Renderer::drawScreenPolygon(const QVector3D* screenPoly, int count, const QRgb* vertexColors)
+{
+	if (count < 3) return;
+
+	if (smoothShading && drawFilledPolygons && depthTest) {
+		//Gouraud, vertex colors interpolated by the rasterizer
+		polygonsDrawn++;
+		for (int i = 1; i + 1 < count; ++i)
+			rasterizer.fillTriangle(screenPoly[0], screenPoly[i], screenPoly[i + 1], vertexColors[0], vertexColors[i], vertexColors[i + 1]);
+		return;
+	}
+
+	//flat, average of the corners
+	int r = 0, g = 0, b = 0;
+	for (int i = 0; i < count; ++i) {
+		r += qRed(vertexColors[i]);
+		g += qGreen(vertexColors[i]);
+		b += qBlue(vertexColors[i]);
+	}
+	drawScreenPolygon(screenPoly, count, qRgb(r / count, g / count, b / count));
+}
+
+QRgb Renderer::shadePolygon(const QVector3D* world, int count)
+{
+	//Base color by height
+	//priemerna vyska poly -> normalizovana v model.normalizeZ()
+	//z farebnej mapy vyberie farba
+	float avgZ = 0;
+	QVector3D center(0, 0, 0);
+	for (int i = 0; i < count; ++i) {
+		avgZ += world[i].z();
+		center += world[i];
+	}
+	avgZ /= count;
+	center /= count;
+
+	float normZ = model.normalizeZ(avgZ);
+	QRgb baseColor = colorLut.lookup(normZ);
+
+	//normal light
+	QVector3D normal = model.computeNormal(world[0], world[1], world[2]);
+	QVector3D toLight = (camera.getLightPosition() - center).normalized();
+
+	float diffuse = std::max(0.0f, QVector3D::dotProduct(normal, toLight));
+	diffuse = std::clamp(diffuse, 0.35f, 1.0f);
+
+	//diffuse <= 1, no clamping needed
+	return qRgb(int(qRed(baseColor) * diffuse), int(qGreen(baseColor) * diffuse), int(qBlue(baseColor) * diffuse));
+}
+
+void Renderer::drawScreenPolygon(const QVector3D* screenPoly, int count, QRgb color)
+{
+	if (count < 3) return;
+	polygonsDrawn++;
+
+	if (drawFilledPolygons && depthTest) {
+		//fan of triangles, depth tested per pixel
+		for (int i = 1; i + 1 < count; ++i)
+			rasterizer.fillTriangle(screenPoly[0], screenPoly[i], screenPoly[i + 1], color);
+	}
+	else if (drawFilledPolygons) {
+		if (count > 4) return;
+		QPointF points[maxClipPoints];
+		QPointF clipped[maxClipPoints];
+		for (int i = 0; i < count; ++i)
+			points[i] = QPointF(int(screenPoly[i].x()), int(screenPoly[i].y()));
+
+		//the edge table is indexed by y, keep it inside the image
+		int clippedCount = clipPolygonToRect(points, count, clipped, 0, target->width() - 1, 0, target->height() - 1);
+		if (clippedCount >= 3)
+			fillPolygonScanLine(*target, clipped, clippedCount, color, arena);
+	}
+	else {
+		//edges
+		for (int i = 0; i < count; ++i) {
+			const QVector3D& p1 = screenPoly[i];
+			const QVector3D& p2 = screenPoly[(i + 1) % count];
+			drawLine(*target, QPoint(int(p1.x()), int(p1.y())), QPoint(int(p2.x()), int(p2.y())), color);
+		}
+	}
+}
+
+QRgb Renderer::mixColors(QRgb a, QRgb b)
+{
+	return qRgb((qRed(a) + qRed(b)) / 2, (qGreen(a) + qGreen(b)) / 2, (qBlue(a) + qBlue(b)) / 2);
+}
+
+template <typename Screen, typename EdgeColor>
+void Renderer::drawLatticeEdges(int nx, int ny, Screen screen, EdgeColor edgeColor)
+{
+	//visible cells of the lattice rows below (j - 1 .. j) and above (j .. j + 1) the current one,
+	//cell i at i + 1, the border slots stay hidden
+	FrameArena::Scope scratch(arena);
+	char* below = arena.allocate<char>(nx + 1);
+	char* above = arena.allocate<char>(nx + 1);
+	std::fill(below, below + nx + 1, 0);
+	auto toPoint = [](const QVector3D& p) { return QPoint(int(p.x()), int(p.y())); };
+
+	for (int j = 0; j < ny; ++j) {
+		if (isCancelled()) return;
+		std::fill(above, above + nx + 1, 0);
+		if (j + 1 < ny) {
+			for (int i = 0; i + 1 < nx; ++i) {
+				QVector3D cell[4] = { screen(i, j), screen(i + 1, j), screen(i + 1, j + 1), screen(i, j + 1) };
+				above[i + 1] = isCellVisible(cell, 4);
+				polygonsDrawn += above[i + 1];
+			}
+		}
+
+		//an edge is shared by two cells, drawn once when either of them is visible
+		for (int i = 0; i < nx; ++i) {
+			QPoint p = toPoint(screen(i, j));
+			if (i + 1 < nx && (below[i + 1] || above[i + 1]))
+				drawLine(*target, p, toPoint(screen(i + 1, j)), edgeColor(i, j, i + 1, j));
+			if (j + 1 < ny && (above[i] || above[i + 1]))
+				drawLine(*target, p, toPoint(screen(i, j + 1)), edgeColor(i, j, i, j + 1));
+		}
+		std::swap(below, above);
+	}
+}
+
+QVector3D Renderer::projectModelPoint(double x, double y, double z)
+{
+	//frameMatrix = view * model, depth grows away from the camera
+	return frameMatrix.map(QVector3D(x, y, z));
+}
+
+void Renderer::showModelTiled()
+{
+	int w = target->width();
+	int h = target->height();
+	const float margin = 20.0f;
+
+	const GridInfo& grid = pyramid.getGrid();
+	ViewFit fit = fitGrid(grid, margin);
+	auto toScreen = [&](const QVector3D& pt) { return fit.toScreen(pt); };
+	setupCulling(grid);
+
+	//coarsest level whose cells still cover ~2 px
+	float midZ = (grid.minZ + grid.maxZ) / 2.0f;
+	QPointF s0 = toScreen(projectModelPoint(grid.originX, grid.originY, midZ));
+	QPointF sx = toScreen(projectModelPoint(grid.xAt(1), grid.originY, midZ)) - s0;
+	QPointF sy = toScreen(projectModelPoint(grid.originX, grid.yAt(1), midZ)) - s0;
+	float cellPixels = std::max(std::hypot(sx.x(), sx.y()), std::hypot(sy.x(), sy.y()));
+	const float targetCellPixels = 2.0f * gridStep;
+
+	int level = 0;
+	while (level + 1 < pyramid.levelCount() && cellPixels * (1 << (level + 1)) <= targetCellPixels)
+		level++;
+
+	drawColorBar();
+	tileLevel = level;
+	tileCache.resetStats();
+
+	const PyramidLevel& info = pyramid.level(level);
+	GridInfo lg = pyramid.levelGrid(level);
+	QRectF screenRect(0, 0, w, h);
+	ProfileScope scope(profiler, "tiles");
+
+	for (int ty = 0; ty < info.tilesY; ++ty) {
+		for (int tx = 0; tx < info.tilesX; ++tx) {
+			if (isCancelled()) return;
+			//visibility from the tile box, before paging it in
+			int c0 = tx * TilePyramid::tileSize, r0 = ty * TilePyramid::tileSize;
+			int c1 = std::min(c0 + TilePyramid::tileSize, lg.cols - 1);
+			int r1 = std::min(r0 + TilePyramid::tileSize, lg.rows - 1);
+			QRectF box;
+			for (int i = 0; i < 8; ++i) {
+				QPointF p = toScreen(projectModelPoint(lg.xAt((i & 1) ? c1 : c0), lg.yAt((i & 2) ? r1 : r0), (i & 4) ? grid.maxZ : grid.minZ));
+				box = i == 0 ? QRectF(p, p) : box.united(QRectF(p, p));
+			}
+			if (!box.intersects(screenRect))
+				continue;
+
+			const Tile* tile = tileCache.tile(level, tx, ty);
+			if (tile == nullptr)
+				continue;
+
+			//project the tile samples once
+			FrameArena::Scope scratch(arena);
+			QVector3D* screen = arena.allocate<QVector3D>(size_t(tile->rows) * tile->cols);
+			QVector3D* world = arena.allocate<QVector3D>(size_t(tile->rows) * tile->cols);
+			for (int r = 0; r < tile->rows; ++r) {
+				for (int c = 0; c < tile->cols; ++c) {
+					QVector3D p(lg.xAt(tile->col0 + c), lg.yAt(tile->row0 + r), tile->heights[r * TilePyramid::tileSamples + c]);
+					world[r * tile->cols + c] = p;
+					screen[r * tile->cols + c] = fit.toScreen3D(projectModelPoint(p.x(), p.y(), p.z()));
+				}
+			}
+
+			if (!drawFilledPolygons) {
+				const int nx = tile->cols;
+				auto edgeColor = [&](int i0, int j0, int i1, int j1) {
+					return colorLut.lookup(model.normalizeZ((world[j0 * nx + i0].z() + world[j1 * nx + i1].z()) / 2));
+				};
+				drawLatticeEdges(nx, tile->rows, [&](int i, int j) { return screen[j * nx + i]; }, edgeColor);
+				continue;
+			}
+			for (int r = 0; r + 1 < tile->rows; ++r) {
+				for (int c = 0; c + 1 < tile->cols; ++c) {
+					int idx = r * tile->cols + c;
+					int quad[4] = { idx, idx + 1, idx + tile->cols + 1, idx + tile->cols };
+					QVector3D corners[4];
+					QVector3D screenPoly[4];
+					for (int i = 0; i < 4; ++i)
+						screenPoly[i] = screen[quad[i]];
+					if (!isCellVisible(screenPoly, 4))
+						continue;
+					for (int i = 0; i < 4; ++i)
+						corners[i] = world[quad[i]];
+					drawScreenPolygon(screenPoly, 4, shadePolygon(corners, 4));
+				}
+			}
+		}
+	}
+}
+
+ViewFit Renderer::fitGrid(const GridInfo& grid, float margin)
+{
+	//fit the grid bounding box instead of every point
+	float minX = std::numeric_limits<float>::max(), maxX = -minX;
+	float minY = minX, maxY = -minX;
+	for (int i = 0; i < 8; ++i) {
+		QVector3D pt = projectModelPoint(grid.xAt((i & 1) ? grid.cols - 1 : 0),
+			grid.yAt((i & 2) ? grid.rows - 1 : 0), (i & 4) ? grid.maxZ : grid.minZ);
+		minX = std::min(minX, pt.x());
+		maxX = std::max(maxX, pt.x());
+		minY = std::min(minY, pt.y());
+		maxY = std::max(maxY, pt.y());
+	}
+	return fitBounds(minX, maxX, minY, maxY, margin);
+}
+
+ViewFit Renderer::fitBounds(float minX, float maxX, float minY, float maxY, float margin)
+{
+	//bounds include the model translation, the fit does not: translating pans the view
+	ViewFit fit;
+	fit.centerX = (minX + maxX) / 2.0f - frameOffset.x();
+	fit.centerY = (minY + maxY) / 2.0f - frameOffset.y();
+	fit.scale = std::min((target->width() - 2 * margin) / (maxX - minX), (target->height() - 2 * margin) / (maxY - minY)) * camera.getZoom();
+	fit.halfW = target->width() / 2.0f;
+	fit.halfH = target->height() / 2.0f;
+	lastFit = fit;
+	return fit;
+}
+
+void Renderer::setupCulling(const GridInfo& grid)
+{
+	//screen winding of a flat cell (origin, +col, +row), y axis flipped on screen
+	QVector3D colStep = frameMatrix.mapVector(QVector3D(grid.spacingX, 0, 0));
+	QVector3D rowStep = frameMatrix.mapVector(QVector3D(0, grid.spacingY, 0));
+	float flatArea = -(colStep.x() * rowStep.y() - colStep.y() * rowStep.x());
+
+	//seen from below (depth falls going down) every cell faces away, the open surface is drawn unculled
+	bool topVisible = frameMatrix.mapVector(QVector3D(0, 0, 1)).z() < 0;
+	frontWinding = 0;
+	if (cullBackFaces && topVisible && flatArea != 0)
+		frontWinding = flatArea > 0 ? 1 : -1;
+}
+
+bool Renderer::isCellVisible(const QVector3D* screenPoly, int count)
+{
+	//all corners beyond one image edge
+	float maxX = target->width() - 1, maxY = target->height() - 1;
+	bool left = true, right = true, top = true, bottom = true;
+	for (int i = 0; i < count; ++i) {
+		left = left && screenPoly[i].x() < 0;
+		right = right && screenPoly[i].x() > maxX;
+		top = top && screenPoly[i].y() < 0;
+		bottom = bottom && screenPoly[i].y() > maxY;
+	}
+	if (left || right || top || bottom)
+		return false;
+
+	if (frontWinding == 0)
+		return true;
+
+	//back facing only if every fan triangle is, a folded cell keeps its front half
+	for (int i = 1; i + 1 < count; ++i) {
+		const QVector3D& a = screenPoly[0];
+		const QVector3D& b = screenPoly[i];
+		const QVector3D& c = screenPoly[i + 1];
+		float area = (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+		if (area * frontWinding > 0)
+			return true;
+	}
+	return false;
+}
+
+void Renderer::setZoom(float zoom)
+{
+	camera.setZoom(std::clamp(zoom, 0.05f, 1000.0f));
+	invalidate(StageGeometry);
+}
+
+void Renderer::zoomBy(float factor)
+{
+	setZoom(camera.getZoom() * factor);
+}
+
+void Renderer::panBy(float dx, float dy)
+{
+	//image fractions to projected units at the last fit, back through the view rotation into the model translation;
+	//the raster views are top-down and north up, there the delta is along the grid axes already
+	if (lastFit.scale <= 0) return;
+	QVector3D viewDelta(dx * 2 * lastFit.halfW / lastFit.scale, -dy * 2 * lastFit.halfH / lastFit.scale, 0);
+	QVector3D delta = renderMode >= ModeHillshade ? viewDelta : camera.viewMatrix().inverted().mapVector(viewDelta);
+	model.setModelTranslation(model.getModelTranslation() + delta);
+	invalidate(StageGeometry);
+}
+
+void Renderer::setZScaleFactor(double factor)
+{
+	model.getZScaleFactor() = factor;
+	invalidate(StageGeometry);
+}
+
+void Renderer::setLightPosition(const QVector3D& position)
+{
+	camera.setLightPosition(position);
+	invalidate(StageColors);
+}
+
+void Renderer::showModelLod()
+{
+	const GridInfo& grid = model.getGrid();
+	bool vertexShading = model.hasNormals();
+
+	//geometry stage: chunk selection and projection, kept in lodMesh
+	if (dirtyStages & StageGeometry) {
+		ProfileScope scope(profiler, "lod select");
+		int w = target->width();
+		int h = target->height();
+		const float margin = 20.0f;
+
+		ViewFit fit = fitGrid(grid, margin);
+		QRectF viewport(0, 0, w, h);
+
+		auto screenBox = [&](const QVector3D& lo, const QVector3D& hi) {
+			QRectF box;
+			for (int i = 0; i < 8; ++i) {
+				QPointF p = fit.toScreen(projectModelPoint((i & 1) ? hi.x() : lo.x(), (i & 2) ? hi.y() : lo.y(), (i & 4) ? hi.z() : lo.z()));
+				box = i == 0 ? QRectF(p, p) : box.united(QRectF(p, p));
+			}
+			return box;
+		};
+
+		//pixels per height unit, for the screen space error
+		QPointF z0 = fit.toScreen(projectModelPoint(grid.originX, grid.originY, 0));
+		QPointF z1 = fit.toScreen(projectModelPoint(grid.originX, grid.originY, 1));
+		float unitZPixels = std::hypot(z1.x() - z0.x(), z1.y() - z0.y());
+
+		lod.select(screenBox, viewport, unitZPixels, lodTolerance * gridStep);
+		setupCulling(grid);
+
+		//cleared, not freed: a selection no larger than an earlier one appends without allocating
+		lodMesh.clear();
+		for (int chunk : lod.selectedChunks()) {
+			LodMesh::Patch patch;
+			lod.chunkVertices(chunk, lodMesh.chunkWorld, patch.nx, patch.ny, &lodMesh.chunkIndices);
+			patch.offset = lodMesh.world.size();
+			lodMesh.patches.append(patch);
+			lodMesh.world += lodMesh.chunkWorld;
+			lodMesh.indices += lodMesh.chunkIndices;
+		}
+
+		lodMesh.screen.resize(lodMesh.world.size());
+		for (int i = 0; i < lodMesh.world.size(); ++i) {
+			const QVector3D& p = lodMesh.world[i];
+			lodMesh.screen[i] = fit.toScreen3D(projectModelPoint(p.x(), p.y(), p.z()));
+		}
+	}
+
+	//color stage, also after a new selection: the vertex set changed
+	if (vertexShading && (dirtyStages & (StageGeometry | StageColors))) {
+		ProfileScope scope(profiler, "shading");
+		lodMesh.colors.resize(lodMesh.world.size());
+		for (int i = 0; i < lodMesh.world.size(); ++i)
+			lodMesh.colors[i] = shadeVertex(lodMesh.indices[i], lodMesh.world[i].z());
+	}
+
+	drawColorBar();
+
+	ProfileScope scope(profiler, drawFilledPolygons ? "cells" : "edges");
+	for (const LodMesh::Patch& patch : lodMesh.patches) {
+		if (isCancelled()) return;
+		const QVector3D* world = lodMesh.world.constData() + patch.offset;
+		const QVector3D* screen = lodMesh.screen.constData() + patch.offset;
+		const QRgb* colors = vertexShading ? lodMesh.colors.constData() + patch.offset : nullptr;
+		int nx = patch.nx, ny = patch.ny;
+
+		if (!drawFilledPolygons) {
+			auto edgeColor = [&](int i0, int j0, int i1, int j1) {
+				int a = j0 * nx + i0, b = j1 * nx + i1;
+				return colors ? mixColors(colors[a], colors[b]) : colorLut.lookup(model.normalizeZ((world[a].z() + world[b].z()) / 2));
+			};
+			drawLatticeEdges(nx, ny, [&](int i, int j) { return screen[j * nx + i]; }, edgeColor);
+			continue;
+		}
+
+		for (int j = 0; j + 1 < ny; ++j) {
+			for (int i = 0; i + 1 < nx; ++i) {
+				int idx = j * nx + i;
+				int quad[4] = { idx, idx + 1, idx + nx + 1, idx + nx };
+				QVector3D corners[4];
+				QVector3D screenPoly[4];
+				for (int k = 0; k < 4; ++k)
+					screenPoly[k] = screen[quad[k]];
+				if (!isCellVisible(screenPoly, 4))
+					continue;
+
+				if (colors) {
+					QRgb quadColors[4];
+					for (int k = 0; k < 4; ++k)
+						quadColors[k] = colors[quad[k]];
+					drawScreenPolygon(screenPoly, 4, quadColors);
+					continue;
+				}
+				for (int k = 0; k < 4; ++k)
+					corners[k] = world[quad[k]];
+				drawScreenPolygon(screenPoly, 4, shadePolygon(corners, 4));
+			}
+		}
+	}
+}
+
+void Renderer::setSmoothShading(bool enabled)
+{
+	smoothShading = enabled;
+	invalidate(StageFrame);
+}
+
+void Renderer::setRenderMode(int mode)
+{
+	if (mode < 0 || mode >= ModeCount) return;
+	renderMode = mode;
+	drawFilledPolygons = mode != ModeWireframe;
+	//built here so renderers sharing this model get it too
+	if (mode == ModeRaycast && rayCaster.isEmpty() && !model.isEmpty()) {
+		ProfileScope scope(profiler, "max mipmap");
+		rayCaster.build(model.getGrid(), model.getHeights());
+	}
+	//the raster modes skip the mesh stages, leaving them stale
+	invalidate(StageGeometry | StageColors);
+}
+
+const char* Renderer::renderModeName(int mode)
+{
+	static const char* names[ModeCount] = { "Filled", "Wireframe", "Raycast", "Hillshade", "Slope", "Aspect" };
+	return mode >= 0 && mode < ModeCount ? names[mode] : "";
+}
+
+void Renderer::showRaster()
+{
+	if (model.isEmpty()) return;
+
+	const GridInfo& grid = model.getGrid();
+	const float* heights = model.getHeights();
+	const int w = target->width();
+	const int h = target->height();
+	const float margin = 20.0f;
+
+	//top-down fit of the grid extent, zoom and pan as in the mesh views, north up
+	double extentX = grid.spacingX * (grid.cols - 1);
+	double extentY = grid.spacingY * (grid.rows - 1);
+	QVector3D translation = model.getModelTranslation();
+	double scale = std::min((w - 2 * margin) / std::abs(extentX), (h - 2 * margin) / std::abs(extentY)) * camera.getZoom();
+	double centerX = grid.originX + extentX / 2 - translation.x();
+	double centerY = grid.originY + extentY / 2 - translation.y();
+	//panBy converts drags with it, grid units per pixel here
+	lastFit.centerX = float(centerX);
+	lastFit.centerY = float(centerY);
+	lastFit.scale = float(scale);
+	lastFit.halfW = w / 2.0f;
+	lastFit.halfH = h / 2.0f;
+
+	//grid sample under each pixel column / row, -1 = outside; the gradient spans one pixel footprint
+	//so zoomed out views average over the skipped samples instead of aliasing
+	FrameArena& tables = arena;
+	auto sampleTable = [scale, &tables](int pixels, double center, double origin, double spacing, int samples, double sign,
+		int*& index, int*& low, int*& high, float*& invDistance) {
+		index = tables.allocate<int>(pixels);
+		low = tables.allocate<int>(pixels);
+		high = tables.allocate<int>(pixels);
+		invDistance = tables.allocate<float>(pixels);
+		int footprint = std::max(1, int(1.0 / (scale * std::abs(spacing)) + 0.5));
+		for (int p = 0; p < pixels; ++p) {
+			double world = center + sign * (p + 0.5 - pixels / 2.0) / scale;
+			int i = int(std::floor((world - origin) / spacing + 0.5));
+			bool inside = i >= 0 && i < samples;
+			index[p] = inside ? i : -1;
+			low[p] = std::max(i - footprint, 0);
+			high[p] = std::min(i + footprint, samples - 1);
+			invDistance[p] = inside ? float(1.0 / ((high[p] - low[p]) * spacing)) : 0.0f;
+		}
+	};
+	int *col, *colLow, *colHigh, *row, *rowLow, *rowHigh;
+	float *invDx, *invDy;
+	{
+		ProfileScope scope(profiler, "raster setup");
+		sampleTable(w, centerX, grid.originX, grid.spacingX, grid.cols, 1.0, col, colLow, colHigh, invDx);
+		sampleTable(h, centerY, grid.originY, grid.spacingY, grid.rows, -1.0, row, rowLow, rowHigh, invDy);
+	}
+
+	const float zScale = model.getZScaleFactor();
+	const int mode = renderMode;
+	const float pi = 3.14159265f;
+	const QRgb flatColor = qRgb(128, 128, 128);
+
+	//one pass over the pixels, row bands per thread
+	ProfileScope scope(profiler, "raster");
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < h; ++y) {
+		int r = row[y];
+		if (r < 0) continue;
+		const float* center = heights + qint64(r) * grid.cols;
+		const float* up = heights + qint64(rowHigh[y]) * grid.cols;
+		const float* down = heights + qint64(rowLow[y]) * grid.cols;
+		float dyScale = zScale * invDy[y];
+		QRgb* line = reinterpret_cast<QRgb*>(target->scanLine(y));
+
+		for (int x = 0; x < w; ++x) {
+			int c = col[x];
+			if (c < 0) continue;
+			float dzdx = (center[colHigh[x]] - center[colLow[x]]) * zScale * invDx[x];
+			float dzdy = (up[c] - down[c]) * dyScale;
+
+			if (mode == ModeSlope) {
+				float slope = std::atan(std::sqrt(dzdx * dzdx + dzdy * dzdy));
+				line[x] = colorLut.lookup(slope / (pi / 2));
+			}
+			else if (mode == ModeAspect) {
+				//compass bearing of the downhill direction, clockwise from north (+y)
+				if (dzdx == 0 && dzdy == 0) {
+					line[x] = flatColor;
+					continue;
+				}
+				float bearing = std::atan2(-dzdx, -dzdy);
+				line[x] = colorLut.lookup(bearing < 0 ? bearing / (2 * pi) + 1 : bearing / (2 * pi));
+			}
+			else {
+				//height color lit by the surface normal (-dz/dx, -dz/dy, 1)
+				QVector3D normal = QVector3D(-dzdx, -dzdy, 1.0f).normalized();
+				float light = 0.2f + 0.8f * std::max(QVector3D::dotProduct(normal, lightDir), 0.0f);
+				QRgb base = colorLut.lookup(model.normalizeZ(center[c]));
+				line[x] = qRgb(int(qRed(base) * light), int(qGreen(base) * light), int(qBlue(base) * light));
+			}
+		}
+	}
+
+	drawColorBar();
+}
+
+void Renderer::showRaycast()
+{
+	if (model.isEmpty()) return;
+
+	const GridInfo& grid = model.getGrid();
+	const float* heights = model.getHeights();
+	if (rayCaster.isEmpty()) {
+		ProfileScope scope(profiler, "max mipmap");
+		rayCaster.build(grid, heights);
+	}
+
+	const int w = target->width();
+	const int h = target->height();
+	const float margin = 20.0f;
+	ViewFit fit = fitGrid(grid, margin);
+
+	//the projection is orthographic: every pixel ray has the same direction (depth grows away from the camera)
+	//screen -> projected -> model -> grid space (column, row, height), all linear
+	bool invertible = false;
+	QMatrix4x4 inverse = frameMatrix.inverted(&invertible);
+	if (!invertible) return;
+	auto toGridSpace = [&grid](const QVector3D& v, bool point) {
+		return QVector3D((v.x() - (point ? grid.originX : 0)) / grid.spacingX, (v.y() - (point ? grid.originY : 0)) / grid.spacingY, v.z());
+	};
+	QVector3D dir = toGridSpace(inverse.mapVector(QVector3D(0, 0, 1)), false);
+	QVector3D center = toGridSpace(inverse.map(QVector3D(fit.centerX, fit.centerY, 0)), true);
+	QVector3D pixelX = toGridSpace(inverse.mapVector(QVector3D(1.0f / fit.scale, 0, 0)), false);
+	QVector3D pixelY = toGridSpace(inverse.mapVector(QVector3D(0, -1.0f / fit.scale, 0)), false);
+
+	const bool vertexShading = model.hasNormals();
+	const int cols = grid.cols;
+
+	//rows are independent, dynamic: rays over empty space are much cheaper than grazing ones
+	ProfileScope scope(profiler, "raycast");
+	#pragma omp parallel for schedule(dynamic, 4)
+	for (int y = 0; y < h; ++y) {
+		if (isCancelled()) continue;
+		QRgb* line = reinterpret_cast<QRgb*>(target->scanLine(y));
+		QVector3D rowOrigin = center + pixelY * (y + 0.5f - fit.halfH);
+
+		for (int x = 0; x < w; ++x) {
+			QVector3D origin = rowOrigin + pixelX * (x + 0.5f - fit.halfW);
+			float t;
+			if (!rayCaster.intersect(origin, dir, t))
+				continue;
+
+			QVector3D hit = origin + dir * t;
+			int cx = std::clamp(int(hit.x()), 0, cols - 2);
+			int cy = std::clamp(int(hit.y()), 0, grid.rows - 2);
+			float u = std::clamp(hit.x() - cx, 0.0f, 1.0f);
+			float v = std::clamp(hit.y() - cy, 0.0f, 1.0f);
+			qint64 i00 = qint64(cy) * cols + cx;
+
+			//vertex normals blended like the Gouraud mesh, else the patch gradient
+			QVector3D normal;
+			if (vertexShading) {
+				normal = (model.normal(i00) * (1 - u) + model.normal(i00 + 1) * u) * (1 - v)
+					+ (model.normal(i00 + cols) * (1 - u) + model.normal(i00 + cols + 1) * u) * v;
+			}
+			else {
+				float h00 = heights[i00], h10 = heights[i00 + 1], h01 = heights[i00 + cols], h11 = heights[i00 + cols + 1];
+				float dzdx = ((h10 - h00) * (1 - v) + (h11 - h01) * v) / grid.spacingX;
+				float dzdy = ((h01 - h00) * (1 - u) + (h11 - h10) * u) / grid.spacingY;
+				normal = QVector3D(-dzdx, -dzdy, 1.0f);
+			}
+
+			float diffuse = std::clamp(QVector3D::dotProduct(normal.normalized(), lightDir), 0.35f, 1.0f);
+			QRgb base = colorLut.lookup(model.normalizeZ(hit.z()));
+			line[x] = qRgb(int(qRed(base) * diffuse), int(qGreen(base) * diffuse), int(qBlue(base) * diffuse));
+		}
+	}
+
+	drawColorBar();
+}
+
+void Renderer::setColorRamp(int index)
+{
+	colorLut.setRamp(ColorRamp(index));
+	invalidate(StageColors);
+}
+
+void Renderer::setLodTolerance(double pixels)
+{
+	lodTolerance = pixels;
+	//may switch between the LOD and the full mesh, both caches are rebuilt
+	invalidate(StageGeometry | StageColors);
+}
+
+void Renderer::setGridStep(int step)
+{
+	step = std::max(step, 1);
+	if (step == gridStep) return;
+	gridStep = step;
+	//the LOD selection depends on it, the full mesh keeps its projection
+	bool lodMeshActive = !tiledRendering && lodTolerance > 0 && !lod.isEmpty();
+	invalidate(lodMeshActive ? StageGeometry : StageFrame);
+}
+
+void Renderer::setTileCacheBudget(qint64 bytes)
+{
+	tileCache.setBudget(bytes);
+}
+
+void Renderer::setPixel(QImage& image, int x, int y, QRgb color)
+{
+	if (!isInside(image, x, y)) return;
+	reinterpret_cast<QRgb*>(image.scanLine(y))[x] = color;
+}
+
+//one Sutherland-Hodgman pass, predicate and intersection are inlined
+template <typename Inside, typename Intersect>
+static int clipPass(const QPointF* input, int count, QPointF* output, Inside inside, Intersect intersect)
+{
+	int n = 0;
+	if (count == 0) return 0;
+
+	QPointF S = input[count - 1];
+	bool S_in = inside(S);
+	for (int i = 0; i < count; ++i)
+	{
+		const QPointF& P = input[i];
+		bool P_in = inside(P);
+		if (P_in)
+		{
+			if (!S_in)
+				output[n++] = intersect(S, P);
+			output[n++] = P;
+		}
+		else if (S_in)
+		{
+			output[n++] = intersect(S, P);
+		}
+		S = P;
+		S_in = P_in;
+	}
+	return n;
+}
+
+//out holds maxClipPoints, count <= 4
+int Renderer::clipPolygonToRect(const QPointF* poly, int count, QPointF* out, float xmin, float xmax, float ymin, float ymax)
+{
+	QPointF tmp[maxClipPoints];
+
+	//left (x >= xmin)
+	count = clipPass(poly, count, tmp,
+		[xmin](const QPointF& p) { return p.x() >= xmin; },
+		[xmin](const QPointF& a, const QPointF& b) {
+			float t = (xmin - a.x()) / (b.x() - a.x());
+			return QPointF(xmin, a.y() + t * (b.y() - a.y()));
+		});
+
+	//right (x <= xmax)
+	count = clipPass(tmp, count, out,
+		[xmax](const QPointF& p) { return p.x() <= xmax; },
+		[xmax](const QPointF& a, const QPointF& b) {
+			float t = (xmax - a.x()) / (b.x() - a.x());
+			return QPointF(xmax, a.y() + t * (b.y() - a.y()));
+		});
+
+	//up (y >= ymin)
+	count = clipPass(out, count, tmp,
+		[ymin](const QPointF& p) { return p.y() >= ymin; },
+		[ymin](const QPointF& a, const QPointF& b) {
+			float t = (ymin - a.y()) / (b.y() - a.y());
+			return QPointF(a.x() + t * (b.x() - a.x()), ymin);
+		});
+
+	//below (y <= ymax)
+	return clipPass(tmp, count, out,
+		[ymax](const QPointF& p) { return p.y() <= ymax; },
+		[ymax](const QPointF& a, const QPointF& b) {
+			float t = (ymax - a.y()) / (b.y() - a.y());
+			return QPointF(a.x() + t * (b.x() - a.x()), ymax);
+		});
+}
+
+bool Renderer::load(QFile& file)
+{
+	QString cachePath = DemCache::cachePath(file.fileName());
+	sourcePath = file.fileName();
+	sourceSize = file.size();
+
+	pyramid.close();
+	tileCache.clear();
+	tiledRendering = false;
+	lod.clear();
+
+	bool cached;
+	{
+		ProfileScope scope(profiler, "load cache");
+		cached = DemCache::isFresh(cachePath, file.fileName()) && model.loadCache(cachePath, sourceSize);
+	}
+	if (cached) {
+		qDebug() << "Cache loaded" << cachePath;
+	}
+	else if (GridReader::canRead(file.fileName())) {
+		//a .hgt is swapped straight into the cache and mapped, the text grid is read and then cached
+		bool read = false;
+		if (file.fileName().endsWith(".hgt", Qt::CaseInsensitive)) {
+			ProfileScope scope(profiler, "parse");
+			read = GridReader::hgtToCache(file, cachePath, sourceSize) && model.loadCache(cachePath, sourceSize);
+		}
+		if (!read) {
+			GridInfo info;
+			QVector<float> values;
+			{
+				ProfileScope scope(profiler, "parse");
+				read = GridReader::read(file, info, values);
+			}
+			ProfileScope scope(profiler, "build grid");
+			if (read && model.setHeights(info, values))
+				model.saveCache(cachePath, sourceSize);
+		}
+	}
+	else {
+		//a regular grid streams into the cache and is mapped from there, the points are never all in memory
+		//scattered points come back parsed instead, they only live until the grid is built
+		XyzParseStats stats;
+		QVector<Point> points;
+		bool streamed;
+		{
+			ProfileScope scope(profiler, "parse");
+			streamed = XyzParser::parseToCache(file, cachePath, sourceSize, points, &stats) && model.loadCache(cachePath, sourceSize);
+			//unmappable input or an unreadable cache: plain parse
+			if (!streamed && points.isEmpty())
+				XyzParser::parse(file, points, &stats);
+		}
+		if (streamed) {
+			XyzParser::printStats("Parsed to cache", stats);
+		}
+		else {
+			XyzParser::printStats("Parsed", stats);
+			ProfileScope scope(profiler, "build grid");
+			if (model.buildGrid(points))
+				model.saveCache(cachePath, sourceSize);
+		}
+		qDebug() << "File loaded";
+	}
+
+	//too big for the full mesh -> page tiles from the pyramid
+	const GridInfo& grid = model.getGrid();
+	if (grid.vertexCount() > tiledVertexThreshold) {
+		ProfileScope scope(profiler, "pyramid");
+		//heights read into memory (rasters, scattered input) move to the mapped cache, pages come back on demand
+		model.moveToCache(cachePath, sourceSize);
+		//tile rows are built from the mapped heights, one row of tiles in memory
+		QString pyramidPath = TilePyramid::pyramidPath(file.fileName());
+		if (!DemCache::isFresh(pyramidPath, file.fileName()) || !pyramid.open(pyramidPath, sourceSize)) {
+			TilePyramid::build(pyramidPath, grid, model.getHeights(), sourceSize);
+			pyramid.open(pyramidPath, sourceSize);
+		}
+		tiledRendering = pyramid.isOpen();
+	}
+
+	return prepareModel();
+}
+
+bool Renderer::prepareModel()
+{
+	model.setupModel();
+	//rebuilt for the new heights when the raycast mode needs it
+	rayCaster.clear();
+	if (!tiledRendering) {
+		{
+			ProfileScope scope(profiler, "lod build");
+			lod.build(model.getGrid(), model.getHeights());
+		}
+		//normals stage right away, renderers sharing the model reuse them
+		ProfileScope scope(profiler, "normals");
+		model.computeNormals();
+	}
+
+	invalidate(StageAll);
+	dirtyStages &= ~StageNormals;
+	return !model.isEmpty();
+}
+
+bool Renderer::shareModel(const Renderer& source)
+{
+	pyramid.close();
+	tileCache.clear();
+	tiledRendering = false;
+
+	//heights, normals and the LOD tree are implicitly shared, nothing is parsed or copied
+	model.share(source.model);
+	lod = source.lod;
+	rayCaster = source.rayCaster;
+	sourcePath = source.sourcePath;
+	sourceSize = source.sourceSize;
+
+	//own file handle on the same pyramid, tiles are cached per renderer
+	if (source.tiledRendering)
+		tiledRendering = pyramid.open(TilePyramid::pyramidPath(sourcePath), sourceSize);
+
+	camera = source.camera;
+	colorLut.setRamp(source.colorLut.getRamp());
+	lodTolerance = source.lodTolerance;
+	smoothShading = source.smoothShading;
+	setRenderMode(source.renderMode);
+
+	invalidate(StageAll);
+	dirtyStages &= ~StageNormals;
+	return !model.isEmpty();
+}
+
+void Renderer::drawColorBar()
+{
+	int w = target->width();
+	int h = target->height();
+
+	const int barWidth = 20;
+	const int barX = w - barWidth - 10;
+	const int barY = 10;
+	const int barHeight = h - 20;
+	if (barX < 0 || barHeight <= 0) return;
+
+	for (int y = 0; y < barHeight; ++y)
+	{
+		float normZ = 1.0f - float(y) / barHeight;
+		QRgb color = colorLut.lookup(normZ);
+
+		QRgb* line = reinterpret_cast<QRgb*>(target->scanLine(barY + y));
+		std::fill(line + barX, line + barX + barWidth, color);
+	}
+}
+
+//Liang-Barsky against [0, maxX] x [0, maxY], false = nothing left
+static bool clipLine(int& x0, int& y0, int& x1, int& y1, int maxX, int maxY)
+{
+	double dx = x1 - x0, dy = y1 - y0;
+	double t0 = 0, t1 = 1;
+	const double p[4] = { -dx, dx, -dy, dy };
+	const double q[4] = { double(x0), double(maxX - x0), double(y0), double(maxY - y0) };
+	for (int i = 0; i < 4; ++i) {
+		if (p[i] == 0) {
+			if (q[i] < 0) return false;
+			continue;
+		}
+		double t = q[i] / p[i];
+		if (p[i] < 0) t0 = std::max(t0, t);
+		else t1 = std::min(t1, t);
+	}
+	if (t0 > t1) return false;
+
+	double sx = x0, sy = y0;
+	x0 = std::clamp(int(std::lround(sx + t0 * dx)), 0, maxX);
+	y0 = std::clamp(int(std::lround(sy + t0 * dy)), 0, maxY);
+	x1 = std::clamp(int(std::lround(sx + t1 * dx)), 0, maxX);
+	y1 = std::clamp(int(std::lround(sy + t1 * dy)), 0, maxY);
+	return true;
+}
+
+void Renderer::drawLine(QImage& image, QPoint start, QPoint end, QRgb color)
+{
+	int x0 = start.x(), y0 = start.y(), x1 = end.x(), y1 = end.y();
+	if (!clipLine(x0, y0, x1, y1, image.width() - 1, image.height() - 1))
+		return;
+
+	//Bresenham along the major axis on a pixel pointer, the minor step is masked in, no branch per pixel
+	const qsizetype stride = image.bytesPerLine() / qsizetype(sizeof(QRgb));
+	int major = std::abs(x1 - x0), minor = std::abs(y1 - y0);
+	qsizetype majorStep = x1 >= x0 ? 1 : -1;
+	qsizetype minorStep = y1 >= y0 ? stride : -stride;
+	if (minor > major) {
+		std::swap(major, minor);
+		std::swap(majorStep, minorStep);
+	}
+
+	QRgb* pixel = reinterpret_cast<QRgb*>(image.scanLine(y0)) + x0;
+	int error = 2 * minor - major;
+	for (int i = 0; i < major; ++i) {
+		*pixel = color;
+		qsizetype carry = -qsizetype(error > 0);   //all ones when the minor axis steps
+		pixel += majorStep + (minorStep & carry);
+		error += 2 * minor - (2 * major & int(carry));
+	}
+	*pixel = color;
+}
+
+void Renderer::fillPolygonScanLine(QImage& image, const QPointF* polygon, int count, QRgb color, FrameArena& arena)
+{
+	if (count < 3) return;
+	FrameArena::Scope scratch(arena);
+
+	//edges setup, at most one per side, sorted by first scanline instead of a table indexed by y
+	EdgeEntry* edges = arena.allocate<EdgeEntry>(count);
+	int edgeCount = 0;
+	int ymin = std::numeric_limits<int>::max();
+	int ymax = std::numeric_limits<int>::min();
+
+	for (int i = 0; i < count; i++) {
+		QPointF p1 = polygon[i];
+		QPointF p2 = polygon[(i + 1) % count];
+
+		if (p1.y() == p2.y()) continue; //horiz skip
+		QPointF upper = p1.y() < p2.y() ? p1 : p2;
+		QPointF lower = p1.y() < p2.y() ? p2 : p1;
+
+		int yStart = std::ceil(upper.y());
+		int yEnd = std::floor(lower.y()) - 1;
+
+		if (yStart > yEnd) continue;
+
+		EdgeEntry entry;
+		entry.x = upper.x();
+		entry.dx = (lower.x() - upper.x()) / (lower.y() - upper.y()); //1/m
+		entry.dy = yEnd - yStart + 1;
+		entry.yStart = yStart;
+		edges[edgeCount++] = entry;
+
+		ymin = std::min(ymin, yStart);
+		ymax = std::max(ymax, yEnd);
+	}
+	std::sort(edges, edges + edgeCount, [](const EdgeEntry& a, const EdgeEntry& b) { return a.yStart < b.yStart; });
+
+	//skanline, clipped to the image
+	EdgeEntry* activeEdges = arena.allocate<EdgeEntry>(edgeCount);
+	int activeCount = 0;
+	int nextEdge = 0;
+	const int maxX = image.width() - 1;
+
+	for (int y = ymin; y <= ymax; ++y) {
+		while (nextEdge < edgeCount && edges[nextEdge].yStart == y)
+			activeEdges[activeCount++] = edges[nextEdge++];
+
+		int kept = 0;
+		for (int i = 0; i < activeCount; ++i)
+			if (activeEdges[i].dy > 0)
+				activeEdges[kept++] = activeEdges[i];
+		activeCount = kept;
+
+		//sort by x
+		std::sort(activeEdges, activeEdges + activeCount, [](const EdgeEntry& a, const EdgeEntry& b) {
+			return a.x < b.x;
+			});
+
+		//draw
+		if (y >= 0 && y < image.height()) {
+			QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+			for (int i = 0; i + 1 < activeCount; i += 2) {
+				int xStart = std::max(int(std::ceil(activeEdges[i].x)), 0);
+				int xEnd = std::min(int(std::floor(activeEdges[i + 1].x)), maxX);
+				if (xStart <= xEnd)
+					std::fill(line + xStart, line + xEnd + 1, color);
+			}
+		}
+
+		for (int i = 0; i < activeCount; ++i) {
+			activeEdges[i].x += activeEdges[i].dx;
+			activeEdges[i].dy -= 1;
+		}
+	}
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <QImage>
+#include <QFile>
+#include <atomic>
+#include "Model.h"
+#include "TilePyramid.h"
+#include "TerrainLod.h"
+#include "RayCaster.h"
+#include "Rasterizer.h"
+#include "VertexTransform.h"
+#include "ColorLut.h"
+#include "Profiler.h"
+#include "FrameArena.h"
+
+
+//LOD frame geometry, the selected chunks back to back
+struct LodMesh {
+	struct Patch { int offset, nx, ny; };
+	QVector<Patch> patches;
+	QVector<QVector3D> world, screen;
+	QVector<qint64> indices;        //grid vertex per mesh vertex
+	QVector<QRgb> colors;
+	QVector<QVector3D> chunkWorld;  //one chunk at a time, kept for its capacity
+	QVector<qint64> chunkIndices;
+	void clear() { patches.clear(); world.clear(); screen.clear(); indices.clear(); colors.clear(); }
+};
+
+//render graph stages, each cached until flagged dirty
+//normals -> colors -> frame, geometry -> frame
+enum RenderStage {
+	StageNormals = 1,
+	StageColors = 2,        //light, colormap
+	StageGeometry = 4,      //model/camera transform, fit, LOD selection
+	StageFrame = 8,         //rasterized image
+	StageAll = 15
+};
+
+//filled / wireframe draw the 3D mesh, raycast marches per pixel through the grid,
+//the others are a top-down image straight from the height grid
+enum RenderMode {
+	ModeFilled,
+	ModeWireframe,
+	ModeRaycast,
+	ModeHillshade,
+	ModeSlope,
+	ModeAspect,
+	ModeCount
+};
+
+//Model, camera and the render graph, draws into any ARGB32 image, no widget
+//setters only flag stages dirty, render() runs them
+//cancel() may be called from another thread, the frame in flight stops at the next row / patch / tile
+class Renderer {
+private:
+	Model model;
+	Camera camera;
+	QImage* target = nullptr;
+	QSize frameSize = QSize(0, 0);
+	QString sourcePath;         //loaded file, locates the pyramid for shareModel()
+	qint64 sourceSize = 0;
+
+	//model * view, composed once per frame in render()
+	QMatrix4x4 frameMatrix;
+	QVector3D frameOffset;     //model translation in projected coordinates, kept out of the fit
+	ViewFit lastFit;           //fit of the last frame, converts pan distances
+	ProjectedGrid projected;
+
+	//culling: frontWinding = screen winding of cells seen from above, 0 = no back-face test this frame
+	bool cullBackFaces = true;
+	int frontWinding = 0;
+
+	int renderMode = ModeFilled;
+	bool drawFilledPolygons = true;
+	ColorLut colorLut;
+
+	//vertex shading from the model normals (full and LOD meshes), smooth = Gouraud, else flat per cell
+	bool smoothShading = true;
+	QVector3D lightDir;
+	std::vector<QRgb> vertexColors;
+
+	//depthTest: triangles through the z-buffered half-space rasterizer, otherwise the old scanline fill
+	//in grid order, kept as the reference path
+	Rasterizer rasterizer;
+	bool depthTest = true;
+
+	//out-of-core path for grids above tiledVertexThreshold
+	TilePyramid pyramid;
+	TileCache tileCache{ pyramid };
+	bool tiledRendering = false;
+	qint64 tiledVertexThreshold = qint64(4096) * 4096;
+	int tileLevel = 0;                  //pyramid level of the last tiled frame, for the overlay
+
+	//geomipmapped mesh, lodTolerance = max screen space height error in px, 0 = full mesh
+	TerrainLod lod;
+	float lodTolerance = 1.0f;
+	LodMesh lodMesh;
+
+	//min-max mipmap for the raycast mode, built on first use
+	RayCaster rayCaster;
+
+	//preview coarsening: cells merged per side on the full mesh, multiplies the LOD tolerance
+	//and the pyramid cell size target
+	int gridStep = 1;
+
+	//stage timers of load and render, polygonsDrawn counted per frame for the HUD / trace
+	Profiler profiler;
+	qint64 polygonsDrawn = 0;
+	bool showHud = false;
+
+	//render temporaries: per polygon / tile scratch from the arena, reset every frame
+	FrameArena arena;
+
+	int dirtyStages = StageAll;
+	std::atomic<bool> cancelled{ false };
+
+	void drawHud();
+public:
+	Renderer();
+
+	//parses the file (or its cache), builds pyramid / LOD, all stages dirty
+	bool load(QFile& file);
+	//after the model was filled in place (buildGrid, generateTestGrid): z range, LOD, normals
+	bool prepareModel();
+	//model, normals and LOD of a loaded renderer, for concurrent renderers of one DEM; source must outlive this
+	bool shareModel(const Renderer& source);
+
+	//runs the dirty stages into image, false = nothing new drawn (unchanged or cancelled)
+	bool render(QImage& image);
+	void invalidate(int stages);
+	void cancel() { cancelled = true; }
+	void resetCancel() { cancelled = false; }
+	bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+	void showModelFull();
+	void showModelTiled();
+	void showModelLod();
+	void showRaster();
+	void showRaycast();
+	ViewFit fitGrid(const GridInfo& grid, float margin);
+	ViewFit fitBounds(float minX, float maxX, float minY, float maxY, float margin);
+	void setupCulling(const GridInfo& grid);
+	bool isCellVisible(const QVector3D* screenPoly, int count);
+	QRgb shadePolygon(const QVector3D* world, int count);
+	void drawScreenPolygon(const QVector3D* screenPoly, int count, QRgb color);
+	void drawScreenPolygon(const QVector3D* screenPoly, int count, const QRgb* vertexColors);
+	//wireframe: every edge of an nx x ny vertex lattice once, screen(i, j) and edgeColor(i0, j0, i1, j1)
+	template <typename Screen, typename EdgeColor>
+	void drawLatticeEdges(int nx, int ny, Screen screen, EdgeColor edgeColor);
+	static QRgb mixColors(QRgb a, QRgb b);
+	QRgb shadeVertex(qint64 index, float z);
+	QVector3D projectModelPoint(double x, double y, double z);
+	void drawColorBar();
+
+	//a pass grows a polygon by at most half its points, quads stay below this
+	static const int maxClipPoints = 32;
+	static int clipPolygonToRect(const QPointF* poly, int count, QPointF* out, float xmin, float xmax, float ymin, float ymax);
+
+	//Draw functions, bounds checked
+	static bool isInside(const QImage& image, int x, int y) { return x >= 0 && y >= 0 && x < image.width() && y < image.height(); }
+	static void setPixel(QImage& image, int x, int y, QRgb color);
+	static void drawLine(QImage& image, QPoint start, QPoint end, QRgb color);
+	//edge list and active edges from the arena, rewound on return
+	static void fillPolygonScanLine(QImage& image, const QPointF* polygon, int count, QRgb color, FrameArena& arena);
+
+	//Get/Set functions
+	Model& getModel() { return model; }
+	Camera& getCamera() { return camera; }
+
+	void setModelRotation(const QVector3D& rotation) { model.setModelRotation(rotation); invalidate(StageGeometry); }
+	void setZoom(float zoom);
+	void zoomBy(float factor);
+	//moves the model by a fraction of the image width / height, y down
+	void panBy(float dx, float dy);
+	void setZScaleFactor(double factor);
+	void setLightPosition(const QVector3D& position);
+	void setColorRamp(int index);
+	void setSmoothShading(bool enabled);
+	void setRenderMode(int mode);
+	int getRenderMode() { return renderMode; }
+	static const char* renderModeName(int mode);
+	void setLodTolerance(double pixels);
+	float getLodTolerance() { return lodTolerance; }
+	void setCullBackFaces(bool enabled) { cullBackFaces = enabled; invalidate(StageGeometry); }
+	void setDepthTest(bool enabled) { depthTest = enabled; invalidate(StageFrame); }
+	bool getDepthTest() { return depthTest; }
+	void setParallelRaster(bool enabled) { rasterizer.setBinned(enabled); invalidate(StageFrame); }
+	void setSimdRaster(bool enabled) { rasterizer.setSimd(enabled); invalidate(StageFrame); }
+	void setTileCacheBudget(qint64 bytes);
+	void setGridStep(int step);
+	int getGridStep() { return gridStep; }
+	Profiler& getProfiler() { return profiler; }
+	void setShowHud(bool enabled) { showHud = enabled; invalidate(StageFrame); }
+	bool getShowHud() { return showHud; }
+};
+
+
+
+struct EdgeEntry {
+	float x;        //
+	float dx;       //1/m
+	int dy;         //scanlines left
+	int yStart;     //first scanline
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+//Plain declarations only: *Avx2.cpp files are compiled with AVX2 enabled and must not
+//share inline code (Qt, STL) with the rest of the program
+
+//out[k] = base[k] + row * rowStep[k] + col * colStep[k] + height * zStep[k]
+struct GridTransformJob {
+	const float* heights;
+	int cols;
+	int rowBegin, rowEnd;
+	float base[3];
+	float rowStep[3];
+	float colStep[3];
+	float zStep[3];
+	float* out[3];          //x, y, depth
+	float minX, maxX, minY, maxY;
+};
+
+void transformGridScalar(GridTransformJob& job);
+void transformGridSse(GridTransformJob& job);
+void transformGridAvx2(GridTransformJob& job);
+
+//one depth tested triangle, already clipped to [minX, maxX] x [minY, maxY]
+//edge i: w = dx * (y - originY) - dy * (x - originX), inside when w > 0 or w == 0 on a top-left edge
+//depth = (w0 * z0 + w1 * z1 + w2 * z2) * invArea, written where it is smaller than the buffer
+//smooth: r, g, b interpolated the same way from the vertex colors and truncated, alpha of rgb[0]
+struct TriangleFillJob {
+	unsigned int* color;        //ARGB32 pixel (0, 0)
+	float* depth;
+	long long colorStride;      //in pixels
+	long long depthStride;
+	int minX, maxX, minY, maxY;
+	float originX[3], originY[3];
+	float dx[3], dy[3];
+	int topLeft[3];
+	float z[3];
+	float invArea;
+	unsigned int rgb[3];        //per vertex, rgb[0] only when not smooth
+	int smooth;
+};
+
+//return the number of pixels written
+int fillTriangleScalar(const TriangleFillJob& tri);
+int fillTriangleSse(const TriangleFillJob& tri);
+int fillTriangleAvx2(const TriangleFillJob& tri);
+
+//set bits of a movemask, internal linkage: every kernel TU keeps its own copy
+static inline int countMaskBits(int mask)
+{
+	int n = 0;
+	for (; mask; mask &= mask - 1)
+		n++;
+	return n;
+}
+
+bool cpuHasAvx2();
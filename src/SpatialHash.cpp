@@ -0,0 +1,94 @@
+#include "SpatialHash.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+void SpatialHash::clear()
+{
+	xs = ys = nullptr;
+	cols = rows = 0;
+	cellStart.clear();
+	items.clear();
+}
+
+int SpatialHash::cellX(double px) const
+{
+	return std::clamp(int((px - minX) / cellSize), 0, cols - 1);
+}
+
+int SpatialHash::cellY(double py) const
+{
+	return std::clamp(int((py - minY) / cellSize), 0, rows - 1);
+}
+
+void SpatialHash::build(const double* x, const double* y, int count)
+{
+	clear();
+	if (count <= 0) return;
+	xs = x;
+	ys = y;
+
+	minX = *std::min_element(x, x + count);
+	minY = *std::min_element(y, y + count);
+	double maxX = *std::max_element(x, x + count);
+	double maxY = *std::max_element(y, y + count);
+
+	//square cells sized for bucketSize points on a uniform spread, the second term bounds
+	//the cell count to ~3 * count / bucketSize on long thin inputs
+	double width = maxX - minX, height = maxY - minY;
+	cellSize = std::max({ std::sqrt(width * height * bucketSize / count), std::max(width, height) * bucketSize / count, 1e-9 });
+	cols = int(width / cellSize) + 1;
+	rows = int(height / cellSize) + 1;
+
+	//counting sort by cell
+	std::vector<int> cell(count);
+	cellStart.assign(size_t(cols) * rows + 1, 0);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < count; ++i)
+		cell[i] = cellY(y[i]) * cols + cellX(x[i]);
+	for (int i = 0; i < count; ++i)
+		cellStart[cell[i] + 1]++;
+	for (size_t c = 1; c < cellStart.size(); ++c)
+		cellStart[c] += cellStart[c - 1];
+
+	items.resize(count);
+	std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	for (int i = 0; i < count; ++i)
+		items[fill[cell[i]]++] = i;
+}
+
+int SpatialHash::nearest(double px, double py) const
+{
+	if (items.empty()) return -1;
+
+	int cx = cellX(px), cy = cellY(py);
+	int best = -1;
+	double bestDist = std::numeric_limits<double>::max();
+
+	//rings of cells around the query, a ring at distance r cannot hold anything closer than (r - 1) cells
+	int maxRing = std::max(cols, rows);
+	for (int ring = 0; ring <= maxRing; ++ring) {
+		double reach = (ring - 1) * cellSize;
+		if (best >= 0 && ring > 0 && reach * reach > bestDist) break;
+
+		for (int y = cy - ring; y <= cy + ring; ++y) {
+			if (y < 0 || y >= rows) continue;
+			//inner rows only visit the two border cells of the ring
+			int step = (y == cy - ring || y == cy + ring) ? 1 : std::max(2 * ring, 1);
+			for (int x = cx - ring; x <= cx + ring; x += step) {
+				if (x < 0 || x >= cols) continue;
+				int c = y * cols + x;
+				for (int k = cellStart[c]; k < cellStart[c + 1]; ++k) {
+					int i = items[k];
+					double dx = xs[i] - px, dy = ys[i] - py;
+					double dist = dx * dx + dy * dy;
+					if (dist < bestDist) {
+						bestDist = dist;
+						best = i;
+					}
+				}
+			}
+		}
+	}
+	return best;
+}
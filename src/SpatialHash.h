@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+
+//Uniform bucket grid over 2D points, about bucketSize points per cell
+//cells are stored compressed: cellStart[c] .. cellStart[c + 1] index into items
+class SpatialHash {
+public:
+	static const int bucketSize = 4;
+
+	void build(const double* x, const double* y, int count);
+	void clear();
+	bool isEmpty() const { return items.empty(); }
+
+	//index of the closest point, -1 when empty
+	int nearest(double px, double py) const;
+
+private:
+	int cellX(double px) const;
+	int cellY(double py) const;
+
+	const double* xs = nullptr;
+	const double* ys = nullptr;
+	double minX = 0, minY = 0, cellSize = 1;
+	int cols = 0, rows = 0;
+	std::vector<int> cellStart;
+	std::vector<int> items;
+};
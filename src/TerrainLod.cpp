@@ -0,0 +1,202 @@
+#include "TerrainLod.h"
+#include <algorithm>
+#include <cmath>
+
+//positions 0, step, 2*step ... always ending on the last sample
+static int latticeCount(int span, int step)
+{
+	return (span + step - 1) / step + 1;
+}
+
+static int latticePos(int from, int to, int step, int i)
+{
+	return std::min(from + i * step, to);
+}
+
+void TerrainLod::clear()
+{
+	grid = GridInfo();
+	heights = nullptr;
+	nChunksX = nChunksY = 0;
+	chunks.clear();
+	nodes.clear();
+	steps.clear();
+	selected.clear();
+}
+
+void TerrainLod::build(const GridInfo& g, const float* h)
+{
+	clear();
+	if (!g.isValid() || h == nullptr)
+		return;
+
+	grid = g;
+	heights = h;
+	nChunksX = (grid.cols - 1 + chunkSize - 1) / chunkSize;
+	nChunksY = (grid.rows - 1 + chunkSize - 1) / chunkSize;
+	chunks.resize(nChunksX * nChunksY);
+	steps.fill(0, chunks.size());
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < chunks.size(); ++i) {
+		LodChunk& chunk = chunks[i];
+		chunk.c0 = (i % nChunksX) * chunkSize;
+		chunk.r0 = (i / nChunksX) * chunkSize;
+		chunk.c1 = std::min(chunk.c0 + chunkSize, grid.cols - 1);
+		chunk.r1 = std::min(chunk.r0 + chunkSize, grid.rows - 1);
+
+		chunk.minZ = chunk.maxZ = height(chunk.r0, chunk.c0);
+		for (int r = chunk.r0; r <= chunk.r1; ++r) {
+			for (int c = chunk.c0; c <= chunk.c1; ++c) {
+				chunk.minZ = std::min(chunk.minZ, height(r, c));
+				chunk.maxZ = std::max(chunk.maxZ, height(r, c));
+			}
+		}
+
+		//error of a level = worst sample vs. bilinear of the decimated lattice
+		chunk.error[0] = 0;
+		for (int l = 1; l < levelCount; ++l) {
+			int step = 1 << l;
+			float err = 0;
+			for (int r = chunk.r0; r <= chunk.r1; ++r) {
+				int ra = chunk.r0 + (r - chunk.r0) / step * step;
+				int rb = std::min(ra + step, chunk.r1);
+				float tr = rb > ra ? float(r - ra) / (rb - ra) : 0.0f;
+				for (int c = chunk.c0; c <= chunk.c1; ++c) {
+					int ca = chunk.c0 + (c - chunk.c0) / step * step;
+					int cb = std::min(ca + step, chunk.c1);
+					float tc = cb > ca ? float(c - ca) / (cb - ca) : 0.0f;
+					float top = height(ra, ca) + tc * (height(ra, cb) - height(ra, ca));
+					float bottom = height(rb, ca) + tc * (height(rb, cb) - height(rb, ca));
+					err = std::max(err, std::abs(height(r, c) - (top + tr * (bottom - top))));
+				}
+			}
+			chunk.error[l] = std::max(err, chunk.error[l - 1]);
+		}
+	}
+
+	nodes.reserve(chunks.size() * 2);
+	buildNode(0, 0, nChunksX, nChunksY);
+}
+
+int TerrainLod::buildNode(int x0, int y0, int x1, int y1)
+{
+	int index = nodes.size();
+	nodes.append(LodNode{ x0, y0, x1, y1, 0, 0, { -1, -1, -1, -1 } });
+
+	if (x1 - x0 == 1 && y1 - y0 == 1) {
+		const LodChunk& chunk = chunks[y0 * nChunksX + x0];
+		nodes[index].minZ = chunk.minZ;
+		nodes[index].maxZ = chunk.maxZ;
+		return index;
+	}
+
+	int mx = x1 - x0 > 1 ? (x0 + x1) / 2 : x1;
+	int my = y1 - y0 > 1 ? (y0 + y1) / 2 : y1;
+	int ranges[4][4] = { { x0, y0, mx, my }, { mx, y0, x1, my }, { x0, my, mx, y1 }, { mx, my, x1, y1 } };
+
+	float minZ = std::numeric_limits<float>::max(), maxZ = -minZ;
+	for (int i = 0; i < 4; ++i) {
+		if (ranges[i][0] >= ranges[i][2] || ranges[i][1] >= ranges[i][3]) continue;
+		int child = buildNode(ranges[i][0], ranges[i][1], ranges[i][2], ranges[i][3]);
+		nodes[index].children[i] = child;
+		minZ = std::min(minZ, nodes[child].minZ);
+		maxZ = std::max(maxZ, nodes[child].maxZ);
+	}
+	nodes[index].minZ = minZ;
+	nodes[index].maxZ = maxZ;
+	return index;
+}
+
+void TerrainLod::select(const std::function<QRectF(const QVector3D&, const QVector3D&)>& screenBox,
+	const QRectF& viewport, float unitZPixels, float tolerance)
+{
+	std::fill(steps.begin(), steps.end(), 0);
+	selected.clear();
+	if (!nodes.isEmpty())
+		selectNode(0, screenBox, viewport, unitZPixels, tolerance);
+}
+
+void TerrainLod::selectNode(int index, const std::function<QRectF(const QVector3D&, const QVector3D&)>& screenBox,
+	const QRectF& viewport, float unitZPixels, float tolerance)
+{
+	const LodNode& node = nodes[index];
+	int c0 = node.chunkX0 * chunkSize, r0 = node.chunkY0 * chunkSize;
+	int c1 = std::min(node.chunkX1 * chunkSize, grid.cols - 1);
+	int r1 = std::min(node.chunkY1 * chunkSize, grid.rows - 1);
+
+	QVector3D lo(grid.xAt(c0), grid.yAt(r0), node.minZ);
+	QVector3D hi(grid.xAt(c1), grid.yAt(r1), node.maxZ);
+	if (!screenBox(lo, hi).intersects(viewport))
+		return;
+
+	if (node.children[0] < 0 && node.children[1] < 0 && node.children[2] < 0 && node.children[3] < 0) {
+		int chunk = node.chunkY0 * nChunksX + node.chunkX0;
+		int level = levelCount - 1;
+		while (level > 0 && chunks[chunk].error[level] * unitZPixels > tolerance)
+			level--;
+		steps[chunk] = 1 << level;
+		selected.append(chunk);
+		return;
+	}
+
+	for (int child : node.children)
+		if (child >= 0)
+			selectNode(child, screenBox, viewport, unitZPixels, tolerance);
+}
+
+//height on a chunk border as the coarser neighbour sees it
+float TerrainLod::edgeHeight(int r, int c, bool vertical, int from, int to, int step) const
+{
+	int p = vertical ? r : c;
+	int a = from + (p - from) / step * step;
+	int b = std::min(a + step, to);
+	if (a == p || b == a)
+		return height(r, c);
+
+	float t = float(p - a) / (b - a);
+	float ha = vertical ? height(a, c) : height(r, a);
+	float hb = vertical ? height(b, c) : height(r, b);
+	return ha + t * (hb - ha);
+}
+
+void TerrainLod::chunkVertices(int index, QVector<QVector3D>& out, int& nx, int& ny, QVector<qint64>* indices) const
+{
+	const LodChunk& chunk = chunks[index];
+	int step = steps[index];
+	int cx = index % nChunksX, cy = index / nChunksX;
+
+	//coarser visible neighbour -> stitch to its lattice
+	auto neighbourStep = [&](int x, int y) {
+		if (x < 0 || y < 0 || x >= nChunksX || y >= nChunksY) return step;
+		int s = steps[y * nChunksX + x];
+		return s > step ? s : step;
+	};
+	int left = neighbourStep(cx - 1, cy), right = neighbourStep(cx + 1, cy);
+	int top = neighbourStep(cx, cy - 1), bottom = neighbourStep(cx, cy + 1);
+
+	nx = latticeCount(chunk.c1 - chunk.c0, step);
+	ny = latticeCount(chunk.r1 - chunk.r0, step);
+	out.resize(nx * ny);
+	if (indices)
+		indices->resize(nx * ny);
+
+	for (int j = 0; j < ny; ++j) {
+		int r = latticePos(chunk.r0, chunk.r1, step, j);
+		for (int i = 0; i < nx; ++i) {
+			int c = latticePos(chunk.c0, chunk.c1, step, i);
+			float z = height(r, c);
+			if (c == chunk.c0 && left > step)
+				z = edgeHeight(r, c, true, chunk.r0, chunk.r1, left);
+			else if (c == chunk.c1 && right > step)
+				z = edgeHeight(r, c, true, chunk.r0, chunk.r1, right);
+			else if (r == chunk.r0 && top > step)
+				z = edgeHeight(r, c, false, chunk.c0, chunk.c1, top);
+			else if (r == chunk.r1 && bottom > step)
+				z = edgeHeight(r, c, false, chunk.c0, chunk.c1, bottom);
+			out[j * nx + i] = QVector3D(grid.xAt(c), grid.yAt(r), z);
+			if (indices)
+				(*indices)[j * nx + i] = qint64(r) * grid.cols + c;
+		}
+	}
+}
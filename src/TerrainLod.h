@@ -0,0 +1,62 @@
+#pragma once
+#include <QVector>
+#include <QVector3D>
+#include <QRectF>
+#include <functional>
+#include "Grid.h"
+
+//Chunked geomipmapping over the regular grid
+//every chunk has steps 1, 2, 4 ... chunkSize with a precomputed max height error per step,
+//chunks are grouped in a quadtree for culling
+struct LodChunk {
+	int c0, r0, c1, r1;         //sample range, inclusive
+	float minZ, maxZ;
+	float error[8];             //max |h - decimated h| per level
+};
+
+struct LodNode {
+	int chunkX0, chunkY0, chunkX1, chunkY1;   //chunk range, exclusive end
+	float minZ, maxZ;
+	int children[4];            //-1 = none
+};
+
+class TerrainLod {
+public:
+	static const int chunkSize = 32;
+	static const int levelCount = 6;            //steps 1..32
+
+	void build(const GridInfo& grid, const float* heights);
+	void clear();
+	bool isEmpty() const { return chunks.isEmpty(); }
+
+	//screenBox maps a world box (min, max corners) to its screen bounding rect
+	//unitZPixels = screen length of one height unit
+	void select(const std::function<QRectF(const QVector3D&, const QVector3D&)>& screenBox,
+		const QRectF& viewport, float unitZPixels, float tolerance);
+
+	//chunks picked by the last select(), step 0 = culled
+	const QVector<int>& selectedChunks() const { return selected; }
+	int chunkStep(int chunk) const { return steps[chunk]; }
+
+	//world vertices of a chunk at its selected step, borders snapped to coarser neighbours
+	//indices = grid vertex index of every output vertex, optional
+	void chunkVertices(int chunk, QVector<QVector3D>& out, int& nx, int& ny, QVector<qint64>* indices = nullptr) const;
+
+	int chunksX() const { return nChunksX; }
+	int chunksY() const { return nChunksY; }
+
+private:
+	float height(int r, int c) const { return heights[qint64(r) * grid.cols + c]; }
+	float edgeHeight(int r, int c, bool vertical, int from, int to, int step) const;
+	int buildNode(int x0, int y0, int x1, int y1);
+	void selectNode(int node, const std::function<QRectF(const QVector3D&, const QVector3D&)>& screenBox,
+		const QRectF& viewport, float unitZPixels, float tolerance);
+
+	GridInfo grid;
+	const float* heights = nullptr;
+	int nChunksX = 0, nChunksY = 0;
+	QVector<LodChunk> chunks;
+	QVector<LodNode> nodes;
+	QVector<int> steps;
+	QVector<int> selected;
+};
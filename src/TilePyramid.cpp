@@ -0,0 +1,200 @@
+#include "TilePyramid.h"
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+
+static const char pyramidMagic[4] = { 'D', 'E', 'M', 'P' };
+static const quint32 pyramidVersion = 1;
+
+static QVector<PyramidLevel> pyramidLevels(const GridInfo& grid)
+{
+	QVector<PyramidLevel> levels;
+	quint64 offset = sizeof(PyramidHeader);
+	int rows = grid.rows, cols = grid.cols;
+
+	while (true) {
+		PyramidLevel level;
+		level.rows = rows;
+		level.cols = cols;
+		level.tilesX = (cols - 1 + TilePyramid::tileSize - 1) / TilePyramid::tileSize;
+		level.tilesY = (rows - 1 + TilePyramid::tileSize - 1) / TilePyramid::tileSize;
+		level.offset = 0;
+		levels.append(level);
+
+		//one tile left or nothing to halve
+		if ((level.tilesX == 1 && level.tilesY == 1) || rows < 3 || cols < 3)
+			break;
+		rows = (rows - 1) / 2 + 1;
+		cols = (cols - 1) / 2 + 1;
+	}
+
+	offset += levels.size() * sizeof(PyramidLevel);
+	for (PyramidLevel& level : levels) {
+		level.offset = offset;
+		offset += quint64(level.tilesX) * level.tilesY * TilePyramid::tileBytes;
+	}
+	return levels;
+}
+
+bool TilePyramid::build(const QString& path, const GridInfo& grid, const float* heights, qint64 sourceSize)
+{
+	if (!grid.isValid() || heights == nullptr)
+		return false;
+
+	QVector<PyramidLevel> levels = pyramidLevels(grid);
+
+	PyramidHeader header;
+	std::memcpy(header.magic, pyramidMagic, sizeof(pyramidMagic));
+	header.version = pyramidVersion;
+	header.tileSize = tileSize;
+	header.levelCount = levels.size();
+	header.originX = grid.originX;
+	header.originY = grid.originY;
+	header.spacingX = grid.spacingX;
+	header.spacingY = grid.spacingY;
+	header.rows = grid.rows;
+	header.cols = grid.cols;
+	header.minZ = grid.minZ;
+	header.maxZ = grid.maxZ;
+	header.sourceSize = quint64(sourceSize);
+
+	QSaveFile out(path);
+	if (!out.open(QIODevice::WriteOnly)) {
+		qWarning() << "Cannot write pyramid" << path;
+		return false;
+	}
+	bool ok = out.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header))
+		&& out.write(reinterpret_cast<const char*>(levels.constData()), levels.size() * sizeof(PyramidLevel)) == qint64(levels.size() * sizeof(PyramidLevel));
+
+	//one row of tiles is filled in parallel, then written
+	QVector<float> band;
+	for (int l = 0; l < levels.size() && ok; ++l) {
+		const PyramidLevel& level = levels[l];
+		band.resize(level.tilesX * tileSamples * tileSamples);
+
+		for (int ty = 0; ty < level.tilesY && ok; ++ty) {
+			#pragma omp parallel for schedule(dynamic)
+			for (int tx = 0; tx < level.tilesX; ++tx) {
+				float* dst = band.data() + qint64(tx) * tileSamples * tileSamples;
+				int row0 = ty * tileSize, col0 = tx * tileSize;
+				int rows = qMin(tileSize, level.rows - 1 - row0) + 1;
+				int cols = qMin(tileSize, level.cols - 1 - col0) + 1;
+
+				for (int r = 0; r < tileSamples; ++r) {
+					qint64 srcRow = qint64(qMin(row0 + r, row0 + rows - 1)) << l;
+					const float* src = heights + srcRow * grid.cols;
+					float* line = dst + r * tileSamples;
+					for (int c = 0; c < cols; ++c)
+						line[c] = src[qint64(col0 + c) << l];
+					//pad with the edge sample
+					for (int c = cols; c < tileSamples; ++c)
+						line[c] = line[cols - 1];
+				}
+			}
+			qint64 bytes = qint64(level.tilesX) * tileBytes;
+			ok = out.write(reinterpret_cast<const char*>(band.constData()), bytes) == bytes;
+		}
+	}
+
+	if (!ok) {
+		qWarning() << "Cannot write pyramid" << path;
+		out.cancelWriting();
+		return false;
+	}
+	qDebug() << "Pyramid built" << path << levels.size() << "levels";
+	return out.commit();
+}
+
+bool TilePyramid::open(const QString& path, qint64 sourceSize)
+{
+	close();
+
+	file.setFileName(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	PyramidHeader header;
+	if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header))
+		|| std::memcmp(header.magic, pyramidMagic, sizeof(pyramidMagic)) != 0
+		|| header.version != pyramidVersion
+		|| header.tileSize != tileSize
+		|| header.sourceSize != quint64(sourceSize)
+		|| header.levelCount < 1) {
+		close();
+		return false;
+	}
+
+	grid.originX = header.originX;
+	grid.originY = header.originY;
+	grid.spacingX = header.spacingX;
+	grid.spacingY = header.spacingY;
+	grid.rows = header.rows;
+	grid.cols = header.cols;
+	grid.minZ = header.minZ;
+	grid.maxZ = header.maxZ;
+
+	levels.resize(header.levelCount);
+	qint64 tableBytes = levels.size() * qint64(sizeof(PyramidLevel));
+	if (file.read(reinterpret_cast<char*>(levels.data()), tableBytes) != tableBytes) {
+		close();
+		return false;
+	}
+
+	const PyramidLevel& last = levels.last();
+	if (file.size() != qint64(last.offset) + qint64(last.tilesX) * last.tilesY * tileBytes) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void TilePyramid::close()
+{
+	if (file.isOpen())
+		file.close();
+	grid = GridInfo();
+	levels.clear();
+}
+
+GridInfo TilePyramid::levelGrid(int l) const
+{
+	GridInfo g = grid;
+	g.spacingX = grid.spacingX * (1 << l);
+	g.spacingY = grid.spacingY * (1 << l);
+	g.rows = levels[l].rows;
+	g.cols = levels[l].cols;
+	return g;
+}
+
+bool TilePyramid::readTile(int l, int tx, int ty, Tile& tile)
+{
+	const PyramidLevel& level = levels[l];
+	tile.level = l;
+	tile.row0 = ty * tileSize;
+	tile.col0 = tx * tileSize;
+	tile.rows = qMin(tileSize, level.rows - 1 - tile.row0) + 1;
+	tile.cols = qMin(tileSize, level.cols - 1 - tile.col0) + 1;
+	tile.heights.resize(tileSamples * tileSamples);
+
+	qint64 offset = qint64(level.offset) + (qint64(ty) * level.tilesX + tx) * tileBytes;
+	return file.seek(offset) && file.read(reinterpret_cast<char*>(tile.heights.data()), tileBytes) == tileBytes;
+}
+
+const Tile* TileCache::tile(int level, int tx, int ty)
+{
+	quint64 key = (quint64(level) << 48) | (quint64(ty) << 24) | quint64(tx);
+	if (Tile* cached = tiles.object(key)) {
+		hits++;
+		return cached;
+	}
+
+	misses++;
+	Tile* loaded = new Tile;
+	if (!pyramid.readTile(level, tx, ty, *loaded)) {
+		delete loaded;
+		return nullptr;
+	}
+
+	tiles.insert(key, loaded, TilePyramid::tileBytes);
+	return loaded;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QCache>
+#include "Grid.h"
+
+//On disk multi-resolution tile store, written next to the source as <name>.demp
+//level 0 = full grid, level L keeps every 2^L-th sample
+//every tile is stored as tileSamples x tileSamples floats, neighbours share the border samples
+struct PyramidHeader {
+	char magic[4];          //"DEMP"
+	quint32 version;
+	qint32 tileSize;
+	qint32 levelCount;
+	double originX, originY;
+	double spacingX, spacingY;
+	qint32 rows, cols;
+	float minZ, maxZ;
+	quint64 sourceSize;
+};
+static_assert(sizeof(PyramidHeader) == 72, "PyramidHeader must stay 72 bytes");
+
+struct PyramidLevel {
+	qint32 rows, cols;      //samples
+	qint32 tilesX, tilesY;
+	quint64 offset;         //file offset of tile (0,0)
+};
+static_assert(sizeof(PyramidLevel) == 24, "PyramidLevel must stay 24 bytes");
+
+struct Tile {
+	int level = 0;
+	int row0 = 0, col0 = 0;     //first sample in level grid
+	int rows = 0, cols = 0;     //valid samples, stride is TilePyramid::tileSamples
+	QVector<float> heights;
+};
+
+class TilePyramid {
+public:
+	static const int tileSize = 256;                //cells per tile side
+	static const int tileSamples = tileSize + 1;
+	static const qint64 tileBytes = qint64(tileSamples) * tileSamples * sizeof(float);
+
+	TilePyramid() = default;
+	TilePyramid(const TilePyramid&) = delete;
+	TilePyramid& operator=(const TilePyramid&) = delete;
+
+	static QString pyramidPath(const QString& sourcePath) { return sourcePath + ".demp"; }
+	//heights are normally the mapped cache, read and written one row of tiles at a time
+	static bool build(const QString& path, const GridInfo& grid, const float* heights, qint64 sourceSize);
+
+	bool open(const QString& path, qint64 sourceSize);
+	void close();
+	bool isOpen() const { return file.isOpen(); }
+
+	const GridInfo& getGrid() const { return grid; }
+	int levelCount() const { return levels.size(); }
+	const PyramidLevel& level(int l) const { return levels[l]; }
+	GridInfo levelGrid(int l) const;
+
+	bool readTile(int level, int tx, int ty, Tile& tile);
+
+private:
+	QFile file;
+	GridInfo grid;
+	QVector<PyramidLevel> levels;
+};
+
+//LRU of paged-in tiles, cost = bytes
+class TileCache {
+public:
+	explicit TileCache(TilePyramid& pyramid) : pyramid(pyramid) { tiles.setMaxCost(256 * 1024 * 1024); }
+
+	void setBudget(qint64 bytes) { tiles.setMaxCost(qMax<qint64>(bytes, TilePyramid::tileBytes)); }
+	qint64 getBudget() const { return tiles.maxCost(); }
+	qint64 getUsed() const { return tiles.totalCost(); }
+
+	//valid until the next tile() call
+	const Tile* tile(int level, int tx, int ty);
+	void clear() { tiles.clear(); }
+
+	//lookups since the last resetStats(), shown in the profiler overlay
+	void resetStats() { hits = misses = 0; }
+	qint64 getHits() const { return hits; }
+	qint64 getMisses() const { return misses; }
+
+private:
+	qint64 hits = 0, misses = 0;
+	TilePyramid& pyramid;
+	QCache<quint64, Tile> tiles;
+};
@@ -0,0 +1,268 @@
+#include "VertexTransform.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <cfloat>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(DEM_SIMD_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+void transformGridScalar(GridTransformJob& job)
+{
+	float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+	for (int r = job.rowBegin; r < job.rowEnd; ++r) {
+		long long row = (long long)r * job.cols;
+		const float* h = job.heights + row;
+		float bx = job.base[0] + r * job.rowStep[0];
+		float by = job.base[1] + r * job.rowStep[1];
+		float bz = job.base[2] + r * job.rowStep[2];
+		for (int c = 0; c < job.cols; ++c) {
+			float x = bx + c * job.colStep[0] + h[c] * job.zStep[0];
+			float y = by + c * job.colStep[1] + h[c] * job.zStep[1];
+			job.out[0][row + c] = x;
+			job.out[1][row + c] = y;
+			job.out[2][row + c] = bz + c * job.colStep[2] + h[c] * job.zStep[2];
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+		}
+	}
+	job.minX = minX;
+	job.maxX = maxX;
+	job.minY = minY;
+	job.maxY = maxY;
+}
+
+#if defined(DEM_SIMD_X86)
+
+static float hmin(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+static float hmax(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+//SSE2 is part of x86-64, no runtime check needed
+void transformGridSse(GridTransformJob& job)
+{
+	const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+	const __m128 colX = _mm_set1_ps(job.colStep[0]), colY = _mm_set1_ps(job.colStep[1]), colZ = _mm_set1_ps(job.colStep[2]);
+	const __m128 hX = _mm_set1_ps(job.zStep[0]), hY = _mm_set1_ps(job.zStep[1]), hZ = _mm_set1_ps(job.zStep[2]);
+	__m128 minX = _mm_set1_ps(FLT_MAX), maxX = _mm_set1_ps(-FLT_MAX);
+	__m128 minY = minX, maxY = maxX;
+	float sMinX = FLT_MAX, sMaxX = -FLT_MAX, sMinY = FLT_MAX, sMaxY = -FLT_MAX;
+
+	for (int r = job.rowBegin; r < job.rowEnd; ++r) {
+		long long row = (long long)r * job.cols;
+		const float* h = job.heights + row;
+		float* ox = job.out[0] + row;
+		float* oy = job.out[1] + row;
+		float* oz = job.out[2] + row;
+		float bx = job.base[0] + r * job.rowStep[0];
+		float by = job.base[1] + r * job.rowStep[1];
+		float bz = job.base[2] + r * job.rowStep[2];
+		const __m128 baseX = _mm_set1_ps(bx), baseY = _mm_set1_ps(by), baseZ = _mm_set1_ps(bz);
+
+		int c = 0;
+		for (; c + 4 <= job.cols; c += 4) {
+			__m128 col = _mm_add_ps(_mm_set1_ps(float(c)), lane);
+			__m128 hv = _mm_loadu_ps(h + c);
+			__m128 x = _mm_add_ps(_mm_add_ps(baseX, _mm_mul_ps(col, colX)), _mm_mul_ps(hv, hX));
+			__m128 y = _mm_add_ps(_mm_add_ps(baseY, _mm_mul_ps(col, colY)), _mm_mul_ps(hv, hY));
+			__m128 z = _mm_add_ps(_mm_add_ps(baseZ, _mm_mul_ps(col, colZ)), _mm_mul_ps(hv, hZ));
+			_mm_storeu_ps(ox + c, x);
+			_mm_storeu_ps(oy + c, y);
+			_mm_storeu_ps(oz + c, z);
+			minX = _mm_min_ps(minX, x);
+			maxX = _mm_max_ps(maxX, x);
+			minY = _mm_min_ps(minY, y);
+			maxY = _mm_max_ps(maxY, y);
+		}
+		for (; c < job.cols; ++c) {
+			float x = bx + c * job.colStep[0] + h[c] * job.zStep[0];
+			float y = by + c * job.colStep[1] + h[c] * job.zStep[1];
+			ox[c] = x;
+			oy[c] = y;
+			oz[c] = bz + c * job.colStep[2] + h[c] * job.zStep[2];
+			sMinX = std::min(sMinX, x);
+			sMaxX = std::max(sMaxX, x);
+			sMinY = std::min(sMinY, y);
+			sMaxY = std::max(sMaxY, y);
+		}
+	}
+
+	job.minX = std::min(hmin(minX), sMinX);
+	job.maxX = std::max(hmax(maxX), sMaxX);
+	job.minY = std::min(hmin(minY), sMinY);
+	job.maxY = std::max(hmax(maxY), sMaxY);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	//OS must save the ymm registers
+	if (!osxsave || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return fma && (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+#else
+
+void transformGridSse(GridTransformJob& job)
+{
+	transformGridScalar(job);
+}
+
+bool cpuHasAvx2()
+{
+	return false;
+}
+
+#endif
+
+typedef void (*GridTransformKernel)(GridTransformJob&);
+
+static bool simdEnabled = true;
+
+static GridTransformKernel selectKernel(const char** name)
+{
+	static const bool avx2 = cpuHasAvx2();
+	if (!simdEnabled) {
+		*name = "scalar";
+		return transformGridScalar;
+	}
+#if defined(DEM_SIMD_X86)
+	if (avx2) {
+		*name = "avx2";
+		return transformGridAvx2;
+	}
+	*name = "sse";
+	return transformGridSse;
+#else
+	*name = "scalar";
+	return transformGridScalar;
+#endif
+}
+
+const char* VertexTransform::kernelName()
+{
+	const char* name;
+	selectKernel(&name);
+	return name;
+}
+
+void VertexTransform::setSimdEnabled(bool enabled)
+{
+	simdEnabled = enabled;
+}
+
+void VertexTransform::transformGrid(const QMatrix4x4& m, const GridInfo& grid, const float* heights, ProjectedGrid& out)
+{
+	qint64 count = grid.vertexCount();
+	//resize keeps the capacity, same size grids do not reallocate
+	out.x.resize(count);
+	out.y.resize(count);
+	out.depth.resize(count);
+	if (count == 0 || heights == nullptr)
+		return;
+
+	const char* name;
+	GridTransformKernel kernel = selectKernel(&name);
+
+	//vertex (r, c) = origin + c * colStep + r * rowStep + h * zStep, affine so the matrix splits per axis
+	QVector3D base = m.map(QVector3D(grid.originX, grid.originY, 0));
+	QVector3D colStep = m.mapVector(QVector3D(grid.spacingX, 0, 0));
+	QVector3D rowStep = m.mapVector(QVector3D(0, grid.spacingY, 0));
+	QVector3D zStep = m.mapVector(QVector3D(0, 0, 1));
+
+	GridTransformJob job;
+	job.heights = heights;
+	job.cols = grid.cols;
+	for (int k = 0; k < 3; ++k) {
+		job.base[k] = base[k];
+		job.colStep[k] = colStep[k];
+		job.rowStep[k] = rowStep[k];
+		job.zStep[k] = zStep[k];
+	}
+	job.out[0] = out.x.data();
+	job.out[1] = out.y.data();
+	job.out[2] = out.depth.data();
+
+	//bands of rows, each band's bounds go to the caller's buffer and are merged afterwards
+	const int bandRows = 64;
+	int bands = (grid.rows + bandRows - 1) / bandRows;
+	out.bandBounds.resize(size_t(bands) * 4);
+	float* bounds = out.bandBounds.data();
+
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < bands; ++b) {
+		GridTransformJob band = job;
+		band.rowBegin = b * bandRows;
+		band.rowEnd = std::min(grid.rows, (b + 1) * bandRows);
+		kernel(band);
+		float* bound = bounds + size_t(b) * 4;
+		bound[0] = band.minX;
+		bound[1] = band.maxX;
+		bound[2] = band.minY;
+		bound[3] = band.maxY;
+	}
+
+	out.minX = out.minY = FLT_MAX;
+	out.maxX = out.maxY = -FLT_MAX;
+	for (int b = 0; b < bands; ++b) {
+		const float* bound = bounds + size_t(b) * 4;
+		out.minX = std::min(out.minX, bound[0]);
+		out.maxX = std::max(out.maxX, bound[1]);
+		out.minY = std::min(out.minY, bound[2]);
+		out.maxY = std::max(out.maxY, bound[3]);
+	}
+}
+
+void VertexTransform::toScreen(ProjectedGrid& points, const ViewFit& fit)
+{
+	//x' = x * scale + offX, y' = -y * scale + offY, plain loop so the compiler vectorizes it
+	const float scale = fit.scale;
+	const float offX = fit.halfW - fit.centerX * scale;
+	const float offY = fit.halfH + fit.centerY * scale;
+	float* x = points.x.data();
+	float* y = points.y.data();
+	qint64 count = qint64(points.x.size());
+	const int blockSize = 1 << 16;
+	int blocks = int((count + blockSize - 1) / blockSize);
+
+#pragma omp parallel for
+	for (int b = 0; b < blocks; ++b) {
+		qint64 end = std::min(count, qint64(b + 1) * blockSize);
+		for (qint64 i = qint64(b) * blockSize; i < end; ++i) {
+			x[i] = x[i] * scale + offX;
+			y[i] = offY - y[i] * scale;
+		}
+	}
+}
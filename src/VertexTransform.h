@@ -0,0 +1,30 @@
+#pragma once
+#include <QMatrix4x4>
+#include <QPointF>
+#include <vector>
+#include "Grid.h"
+
+//screen mapping of projected points, centered and scaled to the image
+struct ViewFit {
+	float centerX = 0, centerY = 0, scale = 1;
+	float halfW = 0, halfH = 0;
+	QPointF toScreen(const QVector3D& pt) const { return QPointF((pt.x() - centerX) * scale + halfW, (centerY - pt.y()) * scale + halfH); }
+	QVector3D toScreen3D(const QVector3D& pt) const { return QVector3D((pt.x() - centerX) * scale + halfW, (centerY - pt.y()) * scale + halfH, pt.z()); }
+};
+
+//grid vertices after the frame matrix, x/y/depth in separate arrays, index = row * cols + col
+struct ProjectedGrid {
+	std::vector<float> x, y, depth;
+	float minX = 0, maxX = 0, minY = 0, maxY = 0;
+	std::vector<float> bandBounds;      //min x, max x, min y, max y per row band, kept for the next frame
+};
+
+class VertexTransform {
+public:
+	//m maps (x, y, height) to (projected x, projected y, depth)
+	static void transformGrid(const QMatrix4x4& m, const GridInfo& grid, const float* heights, ProjectedGrid& out);
+	static void toScreen(ProjectedGrid& points, const ViewFit& fit);
+
+	static const char* kernelName();
+	static void setSimdEnabled(bool enabled);
+};
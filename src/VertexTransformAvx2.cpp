@@ -0,0 +1,85 @@
+#include "SimdKernels.h"
+
+#if defined(DEM_SIMD_X86)
+#include <immintrin.h>
+#include <cfloat>
+
+static inline float hmin(__m256 v)
+{
+	__m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+	return _mm_cvtss_f32(m);
+}
+
+static inline float hmax(__m256 v)
+{
+	__m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+	return _mm_cvtss_f32(m);
+}
+
+void transformGridAvx2(GridTransformJob& job)
+{
+	const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 colX = _mm256_set1_ps(job.colStep[0]), colY = _mm256_set1_ps(job.colStep[1]), colZ = _mm256_set1_ps(job.colStep[2]);
+	const __m256 hX = _mm256_set1_ps(job.zStep[0]), hY = _mm256_set1_ps(job.zStep[1]), hZ = _mm256_set1_ps(job.zStep[2]);
+	__m256 minX = _mm256_set1_ps(FLT_MAX), maxX = _mm256_set1_ps(-FLT_MAX);
+	__m256 minY = minX, maxY = maxX;
+	float sMinX = FLT_MAX, sMaxX = -FLT_MAX, sMinY = FLT_MAX, sMaxY = -FLT_MAX;
+
+	for (int r = job.rowBegin; r < job.rowEnd; ++r) {
+		long long row = (long long)r * job.cols;
+		const float* h = job.heights + row;
+		float* ox = job.out[0] + row;
+		float* oy = job.out[1] + row;
+		float* oz = job.out[2] + row;
+		float bx = job.base[0] + r * job.rowStep[0];
+		float by = job.base[1] + r * job.rowStep[1];
+		float bz = job.base[2] + r * job.rowStep[2];
+		const __m256 baseX = _mm256_set1_ps(bx), baseY = _mm256_set1_ps(by), baseZ = _mm256_set1_ps(bz);
+
+		int c = 0;
+		for (; c + 8 <= job.cols; c += 8) {
+			__m256 col = _mm256_add_ps(_mm256_set1_ps(float(c)), lane);
+			__m256 hv = _mm256_loadu_ps(h + c);
+			__m256 x = _mm256_fmadd_ps(hv, hX, _mm256_fmadd_ps(col, colX, baseX));
+			__m256 y = _mm256_fmadd_ps(hv, hY, _mm256_fmadd_ps(col, colY, baseY));
+			__m256 z = _mm256_fmadd_ps(hv, hZ, _mm256_fmadd_ps(col, colZ, baseZ));
+			_mm256_storeu_ps(ox + c, x);
+			_mm256_storeu_ps(oy + c, y);
+			_mm256_storeu_ps(oz + c, z);
+			minX = _mm256_min_ps(minX, x);
+			maxX = _mm256_max_ps(maxX, x);
+			minY = _mm256_min_ps(minY, y);
+			maxY = _mm256_max_ps(maxY, y);
+		}
+		for (; c < job.cols; ++c) {
+			float x = bx + c * job.colStep[0] + h[c] * job.zStep[0];
+			float y = by + c * job.colStep[1] + h[c] * job.zStep[1];
+			ox[c] = x;
+			oy[c] = y;
+			oz[c] = bz + c * job.colStep[2] + h[c] * job.zStep[2];
+			sMinX = x < sMinX ? x : sMinX;
+			sMaxX = x > sMaxX ? x : sMaxX;
+			sMinY = y < sMinY ? y : sMinY;
+			sMaxY = y > sMaxY ? y : sMaxY;
+		}
+	}
+
+	float vMinX = hmin(minX), vMaxX = hmax(maxX), vMinY = hmin(minY), vMaxY = hmax(maxY);
+	job.minX = vMinX < sMinX ? vMinX : sMinX;
+	job.maxX = vMaxX > sMaxX ? vMaxX : sMaxX;
+	job.minY = vMinY < sMinY ? vMinY : sMinY;
+	job.maxY = vMaxY > sMaxY ? vMaxY : sMaxY;
+}
+
+#else
+
+void transformGridAvx2(GridTransformJob& job)
+{
+	transformGridScalar(job);
+}
+
+#endif
@@ -1,23 +1,42 @@
 ﻿#include   "ViewerWidget.h"
-#include "Model.h"
+#include "AllocationCounter.h"
 
 ViewerWidget::ViewerWidget(QSize imgSize, QWidget* parent)
 	: QWidget(parent)
 {
 	setAttribute(Qt::WA_StaticContents);
 	setMouseTracking(true);
+	//event handling here allocates while frames render, only the render threads are counted
+	AllocationCounter::ignoreThisThread();
 	if (imgSize != QSize(0, 0)) {
 		img = new QImage(imgSize, QImage::Format_ARGB32);
 		img->fill(Qt::white);
+		backImg = new QImage(imgSize, QImage::Format_ARGB32);
 		resizeWidget(img->size());
-		setPainter();
-		setDataPtr();
 	}
+
+	//a queued or running frame holds the navigation input back, up to two frame budgets
+	if (QScreen* screen = QGuiApplication::primaryScreen())
+		scheduler.setRefreshRate(screen->refreshRate());
+	scheduler.setMaxHold(2 * governor.getBudget());
+	scheduler.setCallbacks([this] {
+		std::lock_guard<std::mutex> lock(mutex);
+		return rendering || frameRequested;
+	}, [this](const NavigationInput& input) { applyNavigation(input); });
+
+	worker = std::thread(&ViewerWidget::renderLoop, this);
 }
 ViewerWidget::~ViewerWidget()
 {
-	delete painter;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+		renderer.cancel();
+	}
+	wake.notify_all();
+	worker.join();
 	delete img;
+	delete backImg;
 }
 void ViewerWidget::resizeWidget(QSize size)
 {
@@ -26,258 +45,230 @@ void ViewerWidget::resizeWidget(QSize size)
 	this->setMaximumSize(size);
 }
 
-
-void ViewerWidget::showModel()
+void ViewerWidget::renderLoop()
 {
-	int w = img->width();
-	int h = img->height();
-
-	std::vector<float> zBuffer(w * h, std::numeric_limits<float>::infinity());
-	const float zScale = 1000.0f;
-	const float margin = 20.0f;
-
-	const QVector<Point>& allPoints = model.getPoints();
-	const QVector<QVector<Point*>>& polygons = model.getPolygons();
-
-	//Transformujem a premietam points
-	QVector<QVector3D> cameraPoints;
-	cameraPoints.reserve(allPoints.size());
-	for (const Point& pt : allPoints) {
-		/*QVector3D transformed = camera.transform(QVector3D(pt.x, pt.y, pt.z / zScale));
-		cameraPoints.append(camera.project(transformed));*/
-
-		QVector3D modelPoint(pt.x, pt.y, pt.z/model.getModelScale());
-		QVector3D transformedModel = transformModelPoint(modelPoint);  
-		QVector3D cameraSpace = camera.transform(transformedModel);   
-		cameraPoints.append(camera.project(cameraSpace));
+	typedef std::chrono::steady_clock Clock;
+	auto ready = [this] { return quit || (frameRequested && !paused); };
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		//a preview is shown: full quality once the input has been idle for a while
+		if (previewShown && !ready()) {
+			Clock::time_point refineAt = lastInput + std::chrono::milliseconds(governor.getIdleDelay());
+			if (!wake.wait_until(lock, refineAt, ready) && !paused)
+				frameRequested = true;
+		}
+		wake.wait(lock, ready);
+		if (quit) return;
+
+		std::vector<std::function<void(Renderer&)>> batch;
+		batch.swap(edits);
+		frameRequested = false;
+		rendering = true;
+		//edits posted from here on cancel this frame
+		renderer.resetCancel();
+		QImage* target = backImg;
+		bool interactive = Clock::now() - lastInput < std::chrono::milliseconds(governor.getIdleDelay());
+		QualityLevel quality = interactive ? governor.current() : QualityGovernor::levels[0];
+		lock.unlock();
+
+		for (auto& edit : batch)
+			edit(renderer);
+
+		bool finished = false;
+		QElapsedTimer timer;
+		timer.start();
+		if (target != nullptr) {
+			renderer.setGridStep(quality.gridStep);
+			if (quality.resolutionDivisor > 1) {
+				QSize size = (target->size() / quality.resolutionDivisor).expandedTo(QSize(1, 1));
+				if (previewImg.size() != size)
+					previewImg = QImage(size, QImage::Format_ARGB32);
+				finished = renderer.render(previewImg);
+				if (finished) {
+					//nearest neighbour upscale, blocky but cheap
+					ProfileScope scope(renderer.getProfiler(), "upscale");
+					QPainter painter(target);
+					painter.drawImage(target->rect(), previewImg);
+				}
+			}
+			else {
+				finished = renderer.render(*target);
+			}
+		}
+		double frameMs = timer.nsecsElapsed() / 1e6;
+
+		lock.lock();
+		rendering = false;
+		idle.notify_all();
+		if (finished) {
+			if (interactive)
+				governor.frameRendered(frameMs);
+			previewShown = !quality.isFull();
+			std::swap(img, backImg);
+			QMetaObject::invokeMethod(this, [this] { update(); }, Qt::QueuedConnection);
+		}
+		//a drag cancels every slow frame, the governor has to learn from those too
+		else if (interactive && target != nullptr && !quit)
+			governor.frameAbandoned(frameMs);
 	}
+}
 
-	//model boundaries
-	float minX = cameraPoints[0].x(), maxX = cameraPoints[0].x();
-	float minY = cameraPoints[0].y(), maxY = cameraPoints[0].y();
-	for (const QVector3D& pt : cameraPoints) {
-		minX = std::min(minX, pt.x());
-		maxX = std::max(maxX, pt.x());
-		minY = std::min(minY, pt.y());
-		maxY = std::max(maxY, pt.y());
+void ViewerWidget::post(std::function<void(Renderer&)> edit, bool requestFrame)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		edits.push_back(std::move(edit));
+		if (!requestFrame) return;
+		frameRequested = true;
+		lastInput = std::chrono::steady_clock::now();
+		//the frame in flight is stale now
+		renderer.cancel();
 	}
-	//Center and scale the model
-	float centerX = (minX + maxX) / 2.0f;
-	float centerY = (minY + maxY) / 2.0f;
-	float scaleX = (w - 2 * margin) / (maxX - minX);
-	float scaleY = (h - 2 * margin) / (maxY - minY);
-	float scale = std::min(scaleX, scaleY);
+	wake.notify_one();
+}
 
-	//COLORMAP
-	ColorMap colormap;
-	colormap.addPoint(0.0f, QColor(0, 0, 128));   //blue 
-	colormap.addPoint(0.3f, QColor(0, 255, 0));   //green
-	colormap.addPoint(0.6f, QColor(255, 255, 0)); //yellow
-	colormap.addPoint(1.0f, QColor(255, 0, 0));   //red
+void ViewerWidget::pauseRendering()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	paused = true;
+	renderer.cancel();
+	idle.wait(lock, [this] { return !rendering; });
+}
 
+void ViewerWidget::resumeRendering()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		paused = false;
+		frameRequested = true;
+	}
+	wake.notify_one();
+}
 
-	drawColorBar(colormap);//COLORMAP
+void ViewerWidget::orbitBy(QPointF pixels)
+{
+	scheduler.orbit(pixels);
+}
 
+void ViewerWidget::panBy(QPointF pixels)
+{
+	scheduler.pan(pixels);
+}
 
-	//draw poly
-	for (const auto& poly : model.getPolygons())
+void ViewerWidget::zoomBy(float factor)
+{
+	scheduler.zoom(factor);
+}
+
+void ViewerWidget::applyNavigation(const NavigationInput& input)
+{
+	QSize size(1, 1);
 	{
-		QVector<QPoint> screenPoly;
-		if (poly.size() < 3) continue;
-
-		//Base color by height
-		//priemerna vyska poly -> normalizovana v model.normalizeZ()
-		//z farebnej mapy vyberie farba
-		float avgZ = 0;
-		QVector3D center(0, 0, 0);
-		for (const Point* p : poly) {
-			avgZ += p->z;
-			center += QVector3D(p->x, p->y, p->z);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (img != nullptr)
+			size = img->size().expandedTo(QSize(1, 1));
+	}
+	auto wrap = [](float angle) { return std::remainder(angle, 360.0f); };
+
+	post([this, input, size, wrap](Renderer& r) {
+		//horizontal drag turns around the vertical axis, vertical drag tilts
+		if (!input.orbit.isNull()) {
+			QVector3D rotation = r.getModel().getModelRotation();
+			rotation.setX(wrap(rotation.x() + input.orbit.y() * orbitDegreesPerPixel));
+			rotation.setZ(wrap(rotation.z() + input.orbit.x() * orbitDegreesPerPixel));
+			r.setModelRotation(rotation);
+			emit rotationChanged(rotation);
 		}
-		avgZ /= poly.size();
-		center /= poly.size();
-
-		float normZ = model.normalizeZ(avgZ);
-		QColor baseColor = colormap.getColor(normZ);
-
-		//normal light
-		QVector3D normal = model.computeNormal(poly);
-		QVector3D toLight = (camera.getLightPosition() - center).normalized();
+		if (!input.pan.isNull())
+			r.panBy(float(input.pan.x() / size.width()), float(input.pan.y() / size.height()));
+		if (input.zoom != 1.0f)
+			r.zoomBy(input.zoom);
+	});
+}
 
-		float diffuse = std::max(0.0f, QVector3D::dotProduct(normal, toLight));
-		diffuse = std::clamp(diffuse, 0.35f, 1.0f);
+void ViewerWidget::setCullBackFaces(bool enabled)
+{
+	post([enabled](Renderer& r) { r.setCullBackFaces(enabled); });
+}
 
-		QColor litColor = QColor(
-			std::clamp(int(baseColor.red() * diffuse), 0, 255),
-			std::clamp(int(baseColor.green() * diffuse), 0, 255),
-			std::clamp(int(baseColor.blue() * diffuse), 0, 255)
-		);
+void ViewerWidget::setDepthTest(bool enabled)
+{
+	post([enabled](Renderer& r) { r.setDepthTest(enabled); });
+}
 
-		
+void ViewerWidget::setParallelRaster(bool enabled)
+{
+	post([enabled](Renderer& r) { r.setParallelRaster(enabled); });
+}
 
+void ViewerWidget::setSimdRaster(bool enabled)
+{
+	post([enabled](Renderer& r) { r.setSimdRaster(enabled); });
+}
 
-		//projection coord are centered and scaled
-		for (const Point* p : poly)
-		{
-			int index = p - &model.getPoints()[0];
-			if (index < 0 || index >= cameraPoints.size()) continue;
+void ViewerWidget::setTileCacheBudget(qint64 bytes)
+{
+	post([bytes](Renderer& r) { r.setTileCacheBudget(bytes); }, false);
+}
 
-			const QVector3D& pt = cameraPoints[index];
-			float x = (pt.x() - centerX) * scale + w / 2.0f;
-			float y = (centerY - pt.y()) * scale + h / 2.0f;
-			screenPoly.append(QPoint(int(x), int(y)));
-		}
+void ViewerWidget::setShowHud(bool enabled)
+{
+	post([enabled](Renderer& r) { r.setShowHud(enabled); });
+}
 
-		if (screenPoly.size() >= 3) {
-			if (drawFilledPolygons) {
-				QVector<QPointF> screenPolyF;
-				for (const QPoint& pt : screenPoly)
-					screenPolyF.append(QPointF(pt));
+bool ViewerWidget::exportTrace(const QString& path)
+{
+	return renderer.getProfiler().writeChromeTrace(path);
+}
 
-				fillPolygonScanLine(screenPolyF, litColor);
-			}
-			else {
-				//edges
-				for (int i = 0; i < screenPoly.size(); ++i) {
-					const QPoint& p1 = screenPoly[i];
-					const QPoint& p2 = screenPoly[(i + 1) % screenPoly.size()];
-					drawLine(p1, p2, litColor);
-				}
-			}
-		}
-	
-	}
+void ViewerWidget::setFrameBudget(double ms)
+{
+	scheduler.setMaxHold(2 * ms);
+	std::lock_guard<std::mutex> lock(mutex);
+	governor.setBudget(ms);
 }
 
 void ViewerWidget::showPoints()
 {
+	pauseRendering();
+	Model& model = renderer.getModel();
 	int w = img->width();
 	int h = img->height();
 
-	
-	QVector<QPointF> screenPoints = camera.toScreenCoordinates(model.getPoints(), w, h, 20.0f);
+	QVector<QVector3D> points(model.getGrid().vertexCount());
+	for (qint64 i = 0; i < points.size(); ++i)
+		points[i] = model.vertex(i);
+	QVector<QPointF> screenPoints = renderer.getCamera().toScreenCoordinates(points, w, h, 20.0f);
 
 	for (const QPointF& pt : screenPoints) {
 		setPixel((int)pt.x(), (int)pt.y(), Qt::blue);
 	}
-}
-
-QVector<QPointF> ViewerWidget::clipPolygonToRect(const QVector<QPointF>& poly, float xmin, float xmax, float ymin, float ymax)
-{
-	auto clip = [](const QVector<QPointF>& input, std::function<bool(const QPointF&)> inside,
-		std::function<QPointF(const QPointF&, const QPointF&)> intersect) -> QVector<QPointF>
-		{
-			QVector<QPointF> output;
-			if (input.isEmpty()) return output;
-
-			QPointF S = input.last();
-
-			for (const QPointF& P : input)
-			{
-				bool S_in = inside(S);
-				bool P_in = inside(P);
-
-				if (P_in)
-				{
-					if (!S_in)
-						output.append(intersect(S, P));
-					output.append(P);
-				}
-				else if (S_in)
-				{
-					output.append(intersect(S, P));
-				}
-				S = P;
-			}
-
-			return output;
-		};
-
-	QVector<QPointF> result = poly;
-
-	//left (x >= xmin)
-	result = clip(result,
-		[xmin](const QPointF& p) { return p.x() >= xmin; },
-		[xmin](const QPointF& a, const QPointF& b) {
-			float t = (xmin - a.x()) / (b.x() - a.x());
-			float y = a.y() + t * (b.y() - a.y());
-			return QPointF(xmin, y);
-		});
-
-	//right (x <= xmax)
-	result = clip(result,
-		[xmax](const QPointF& p) { return p.x() <= xmax; },
-		[xmax](const QPointF& a, const QPointF& b) {
-			float t = (xmax - a.x()) / (b.x() - a.x());
-			float y = a.y() + t * (b.y() - a.y());
-			return QPointF(xmax, y);
-		});
-
-	//up (y >= ymin)
-	result = clip(result,
-		[ymin](const QPointF& p) { return p.y() >= ymin; },
-		[ymin](const QPointF& a, const QPointF& b) {
-			float t = (ymin - a.y()) / (b.y() - a.y());
-			float x = a.x() + t * (b.x() - a.x());
-			return QPointF(x, ymin);
-		});
-
-	//below (y <= ymax)
-	result = clip(result,
-		[ymax](const QPointF& p) { return p.y() <= ymax; },
-		[ymax](const QPointF& a, const QPointF& b) {
-			float t = (ymax - a.y()) / (b.y() - a.y());
-			float x = a.x() + t * (b.x() - a.x());
-			return QPointF(x, ymax);
-		});
-
-	return result;
+	resumeRendering();
+	update();
 }
 
 
 //Image functions
 bool ViewerWidget::setImage(QFile& file)
 {
-	
-	QTextStream in(&file);
-	
-	while (!in.atEnd()) {
-		QString line = in.readLine().trimmed();
-		if (line.isEmpty()) continue;
-
-		QStringList parts = line.split(QRegularExpression("\\s+"));
-		if (parts.size() != 3) {
-			qWarning() << "Bad line" << line;
-			continue;
-		}
-
-		bool ok1, ok2, ok3;
-		double x = parts[0].toDouble(&ok1);
-		double y = parts[1].toDouble(&ok2);
-		double z = parts[2].toDouble(&ok3);
-
-		if (ok1 && ok2 && ok3) {
-			Point point{ x,y,z };
-			model.getPoints().append(point);
-		}
-		
-	}
+	//the model is replaced under the renderer, the worker waits
+	pauseRendering();
+	bool loaded = renderer.load(file);
+	resumeRendering();
 
-	update();
-
-	qDebug() << "File loaded";
-	//model.generateTestGrid(5, 5, 1.0); // TESTTTTT
-	model.setupModel();
-	clear();
-	showModel();
-	
 	//drawCameraAxes(camera,img->width(), img->height(), 100);
 	//showPoints(); // TEST
-	return true;
-
+	return loaded;
+}
+QImage ViewerWidget::grabFrame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return img ? img->copy() : QImage();
 }
 bool ViewerWidget::isEmpty()
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	if (img == nullptr) {
 		return true;
 	}
@@ -293,19 +284,18 @@ bool ViewerWidget::changeSize(int width, int height)
 	QSize newSize(width, height);
 
 	if (newSize != QSize(0, 0)) {
-		if (img != nullptr) {
-			delete painter;
+		pauseRendering();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
 			delete img;
+			delete backImg;
+			img = new QImage(newSize, QImage::Format_ARGB32);
+			img->fill(Qt::white);
+			backImg = new QImage(newSize, QImage::Format_ARGB32);
 		}
-
-		img = new QImage(newSize, QImage::Format_ARGB32);
-		if (!img) {
-			return false;
-		}
-		img->fill(Qt::white);
 		resizeWidget(img->size());
-		setPainter();
-		setDataPtr();
+		//the renderer sees the new size and refits
+		resumeRendering();
 		update();
 	}
 
@@ -314,16 +304,8 @@ bool ViewerWidget::changeSize(int width, int height)
 
 void ViewerWidget::setPixel(int x, int y, uchar r, uchar g, uchar b, uchar a)
 {
-	r = r > 255 ? 255 : (r < 0 ? 0 : r);
-	g = g > 255 ? 255 : (g < 0 ? 0 : g);
-	b = b > 255 ? 255 : (b < 0 ? 0 : b);
-	a = a > 255 ? 255 : (a < 0 ? 0 : a);
-
-	size_t startbyte = y * img->bytesPerLine() + x * 4;
-	data[startbyte] = b;
-	data[startbyte + 1] = g;
-	data[startbyte + 2] = r;
-	data[startbyte + 3] = a;
+	std::lock_guard<std::mutex> lock(mutex);
+	Renderer::setPixel(*img, x, y, qRgba(r, g, b, a));
 }
 void ViewerWidget::setPixel(int x, int y, double valR, double valG, double valB, double valA)
 {
@@ -332,183 +314,23 @@ void ViewerWidget::setPixel(int x, int y, double valR, double valG, double valB,
 	valB = valB > 1 ? 1 : (valB < 0 ? 0 : valB);
 	valA = valA > 1 ? 1 : (valA < 0 ? 0 : valA);
 
-	size_t startbyte = y * img->bytesPerLine() + x * 4;
-	data[startbyte] = static_cast<uchar>(255 * valB);
-	data[startbyte + 1] = static_cast<uchar>(255 * valG);
-	data[startbyte + 2] = static_cast<uchar>(255 * valR);
-	data[startbyte + 3] = static_cast<uchar>(255 * valA);
+	std::lock_guard<std::mutex> lock(mutex);
+	Renderer::setPixel(*img, x, y, qRgba(int(255 * valR), int(255 * valG), int(255 * valB), int(255 * valA)));
 }
 void ViewerWidget::setPixel(int x, int y, const QColor& color)
 {
-	if (color.isValid()) {
-		size_t startbyte = y * img->bytesPerLine() + x * 4;
-
-		data[startbyte] = color.blue();
-		data[startbyte + 1] = color.green();
-		data[startbyte + 2] = color.red();
-		data[startbyte + 3] = color.alpha();
-	}
+	if (!color.isValid()) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	Renderer::setPixel(*img, x, y, color.rgba());
 }
 
 //Draw functions
 void ViewerWidget::drawLine(QPoint start, QPoint end, QColor color)
 {
-	int deltaY = (end.y() - start.y());
-	int deltaX = (end.x() - start.x());
-
-	int x, y, x1, y1, x2, y2, k1, k2, p1;
-	double m;
-
-	if (start.x() == end.x()) {  // vert
-		int y1 = std::min(start.y(), end.y());
-		int y2 = std::max(start.y(), end.y());
-		for (int y = y1; y <= y2; ++y) {
-			setPixel(start.x(), y, color);
-		}
-		update();
-		return;
-	}
-	if (start.y() == end.y()) {  // horiz
-		int x1 = std::min(start.x(), end.x());
-		int x2 = std::max(start.x(), end.x());
-		for (int x = x1; x <= x2; ++x) {
-			setPixel(x, start.y(), color);
-		}
-		update();
-		return;
-	}
-
-
-	if (deltaX != 0) {
-		m = static_cast<double>(deltaY) / static_cast<double>(deltaX);
-	}
-	else {
-		m = static_cast<double>(deltaY) / DBL_MAX;
-	}
-	if (((m > 0) && (m < 1)) || ((m > -1) && (m < 0)))
 	{
-		//qDebug() << "X";
-		//x
-		//BeginEndPoints
-		if (end.x() > start.x()) {
-			x1 = start.x();
-			x2 = end.x();
-			y1 = start.y();
-			y2 = end.y();
-		}
-		else {
-			x1 = end.x();
-			x2 = start.x();
-			y1 = end.y();
-			y2 = start.y();
-			deltaX *= -1;
-			deltaY *= -1;
-		}
-		//Algorithm
-		if ((m > 0) && (m < 1)) {
-			//qDebug() << "X1";
-			k1 = 2 * deltaY;
-			k2 = 2 * deltaY - 2 * deltaX;
-			p1 = 2 * deltaY - deltaX;
-			x = x1;
-			y = y1;
-			setPixel(x, y, color);
-			while (x < x2)
-			{
-				x++;
-				if (p1 > 0) {
-					y++;
-					p1 += k2;
-				}
-				else {
-					p1 += k1;
-				}
-				setPixel(x, y, color);
-			}
-		}
-		else {
-			//qDebug() << "X2";
-			k1 = 2 * deltaY;
-			k2 = 2 * deltaY + 2 * deltaX;
-			p1 = 2 * deltaY + deltaX;
-			x = x1;
-			y = y1;
-			setPixel(x, y, color);
-			while (x < x2)
-			{
-				x++;
-				if (p1 < 0) {
-					y--;
-					p1 += k2;
-				}
-				else {
-					p1 += k1;
-				}
-				setPixel(x, y, color);
-			}
-		}
+		std::lock_guard<std::mutex> lock(mutex);
+		Renderer::drawLine(*img, start, end, color.rgba());
 	}
-	else {
-		//qDebug() << "Y";
-		//y
-		//BeginEndPoints
-		if (end.y() > start.y()) {
-			x1 = start.x();
-			x2 = end.x();
-			y1 = start.y();
-			y2 = end.y();
-		}
-		else {
-			x1 = end.x();
-			x2 = start.x();
-			y1 = end.y();
-			y2 = start.y();
-			deltaX *= -1;
-			deltaY *= -1;
-		}
-		//Algorithm
-		if (m > 0) {
-			k1 = 2 * deltaX;
-			k2 = 2 * deltaX - 2 * deltaY;
-			p1 = 2 * deltaX - deltaY;
-			x = x1;
-			y = y1;
-			setPixel(x, y, color);
-			while (y < y2)
-			{
-				y++;
-				if (p1 > 0) {
-					x++;
-					p1 += k2;
-				}
-				else {
-					p1 += k1;
-				}
-				setPixel(x, y, color);
-			}
-		}
-		else {
-			k1 = 2 * deltaX;
-			k2 = 2 * deltaX + 2 * deltaY;
-			p1 = 2 * deltaX + deltaY;
-			x = x1;
-			y = y1;
-			setPixel(x, y, color);
-			while (y < y2)
-			{
-				y++;
-				if (p1 < 0) {
-					x--;
-					p1 += k2;
-				}
-				else {
-					p1 += k1;
-				}
-				setPixel(x, y, color);
-			}
-		}
-	}
-
 	update();
 }
 
@@ -534,148 +356,26 @@ void ViewerWidget::drawCameraAxes(Camera& camera, int screenWidth, int screenHei
     drawLine(toScreen(origin), toScreen(n_end), Qt::blue);
 }
 
-void ViewerWidget::drawColorBar(const ColorMap& colormap)
-{
-	int w = img->width();
-	int h = img->height();
-
-	const int barWidth = 20;
-	const int barX = w - barWidth - 10;
-	const int barY = 10;
-	const int barHeight = h - 20;
-
-	for (int y = 0; y < barHeight; ++y)
-	{
-		
-		float normZ = 1.0f - float(y) / barHeight;
-
-		QColor color = colormap.getColor(normZ);
-
-		for (int x = 0; x < barWidth; ++x)
-		{
-			setPixel(barX + x, barY + y, color);
-		}
-	}
-}
-
 void ViewerWidget::drawPoly(QVector<QPoint> points, QColor color)
 {
-	for (int i = 0; i < points.size(); i++)
+	//one repaint for the whole outline
 	{
-		drawLine(points[i], points[(i + 1) % points.size()], color);
-	}
-}
-
-
-void ViewerWidget::fillPolygonScanLine(const QVector<QPointF>& polygon, const QColor& color)
-{
-	if (polygon.size() < 3) return;
-
-	//edges setup
-	QVector<QVector<EdgeEntry>> edgeTable;
-
-	int ymin = std::numeric_limits<int>::max();
-	int ymax = std::numeric_limits<int>::min();
-
-	for (int i = 0; i < polygon.size(); i++) {
-		QPointF p1 = polygon[i];
-		QPointF p2 = polygon[(i + 1) % polygon.size()];
-
-		if (p1.y() == p2.y()) continue; //horiz skip
-		QPointF upper = p1.y() < p2.y() ? p1 : p2;
-		QPointF lower = p1.y() < p2.y() ? p2 : p1;
-
-		int yStart = std::ceil(upper.y());
-		int yEnd = std::floor(lower.y()) - 1;
-
-		if (yStart > yEnd) continue;
-
-		float dx = (lower.x() - upper.x()) / (lower.y() - upper.y()); //m
-
-		while (edgeTable.size() <= yEnd)
-		{
-			edgeTable.append(QVector<EdgeEntry>());
-		}
-
-		EdgeEntry entry;
-		entry.x = upper.x();
-		entry.dx = dx;
-		entry.dy = yEnd - yStart + 1;
-
-		edgeTable[yStart].append({ entry });
-
-		ymin = std::min(ymin, yStart);
-		ymax = std::max(ymax, yEnd);
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int i = 0; i < points.size(); i++)
+			Renderer::drawLine(*img, points[i], points[(i + 1) % points.size()], color.rgba());
 	}
-
-	//skanline
-	QVector<EdgeEntry> activeEdges;
-
-	for (int y = ymin; y <= ymax; ++y) {
-		if (y < edgeTable.size()) {
-			for (EdgeEntry& e : edgeTable[y]) {
-				activeEdges.append(e);
-			}
-		}
-
-		for (int i = 0; i < activeEdges.size(); ) {
-			if (activeEdges[i].dy <= 0)
-				activeEdges.removeAt(i);
-			else
-				++i;
-		}
-
-		//sort by x
-		std::sort(activeEdges.begin(), activeEdges.end(), [](const EdgeEntry& a, const EdgeEntry& b) {
-			return a.x < b.x;
-			});
-
-		//draw
-		for (int i = 0; i + 1 < activeEdges.size(); i += 2) {
-			int xStart = std::ceil(activeEdges[i].x);
-			int xEnd = std::floor(activeEdges[i + 1].x);
-
-			for (int x = xStart; x <= xEnd; ++x) {
-				setPixel(x, y, color);
-			}
-		}
-
-		for (EdgeEntry& e : activeEdges) {
-			e.x += e.dx;
-			e.dy -= 1;
-		}
-	}
-}
-
-QVector3D ViewerWidget::transformModelPoint(const QVector3D& p)
-{
-	QVector3D point = p;
-
-
-
-	QMatrix4x4 mat;
-	mat.rotate(model.getModelRotation().x(), 1, 0, 0);
-	mat.rotate(model.getModelRotation().y(), 0, 1, 0);
-	mat.rotate(model.getModelRotation().z(), 0, 0, 1);
-
-
-	mat.scale(model.getModelScale(), model.getModelScale(), model.getModelScale() * model.getZScaleFactor());
-
-
-	point = mat * point;
-
-
-	point += model.getModelTranslation();
-
-	return point;
+	update();
 }
 
-
-
 void ViewerWidget::clear()
 {
-	img->fill(Qt::white);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		img->fill(Qt::white);
+	}
 	update();
+	//cached stages stay, the next frame only redraws
+	post([](Renderer& r) { r.invalidate(StageFrame); }, false);
 }
 
 
@@ -683,28 +383,60 @@ void ViewerWidget::clear()
 //Slots
 void ViewerWidget::paintEvent(QPaintEvent* event)
 {
+	//the profiler is thread safe, the blit lands in the next frame's breakdown
+	ProfileScope scope(renderer.getProfiler(), "blit");
 	QPainter painter(this);
 	QRect area = event->rect();
+	std::lock_guard<std::mutex> lock(mutex);
 	painter.drawImage(area, *img, area);
 }
 
 void ViewerWidget::setModelRotationX(double angle)
 {
-	model.setModelRotation(QVector3D(angle, model.getModelRotation().y(), model.getModelRotation().z()));
-	update();
-	clear();
-	showModel();
+	post([angle](Renderer& r) {
+		QVector3D rotation = r.getModel().getModelRotation();
+		r.setModelRotation(QVector3D(angle, rotation.y(), rotation.z()));
+	});
 }
 void ViewerWidget::setModelRotationY(double angle) {
-	model.setModelRotation(QVector3D(model.getModelRotation().x(), angle, model.getModelRotation().z()));
-	update();
-	clear();
-	showModel();
+	post([angle](Renderer& r) {
+		QVector3D rotation = r.getModel().getModelRotation();
+		r.setModelRotation(QVector3D(rotation.x(), angle, rotation.z()));
+	});
 }
 void ViewerWidget::setModelRotationZ(double angle) {
-	model.setModelRotation(QVector3D(model.getModelRotation().x(), model.getModelRotation().y(), angle));
-	update();
-	clear();
-	showModel();
+	post([angle](Renderer& r) {
+		QVector3D rotation = r.getModel().getModelRotation();
+		r.setModelRotation(QVector3D(rotation.x(), rotation.y(), angle));
+	});
+}
+
+void ViewerWidget::setLodTolerance(double pixels)
+{
+	post([pixels](Renderer& r) { r.setLodTolerance(pixels); });
+}
+
+void ViewerWidget::setRenderMode(int mode)
+{
+	post([mode](Renderer& r) { r.setRenderMode(mode); });
 }
 
+void ViewerWidget::setColorRamp(int index)
+{
+	post([index](Renderer& r) { r.setColorRamp(index); });
+}
+
+void ViewerWidget::setSmoothShading(bool enabled)
+{
+	post([enabled](Renderer& r) { r.setSmoothShading(enabled); });
+}
+
+void ViewerWidget::setZScaleFactor(double factor)
+{
+	post([factor](Renderer& r) { r.setZScaleFactor(factor); });
+}
+
+void ViewerWidget::setLightPosition(const QVector3D& position)
+{
+	post([position](Renderer& r) { r.setLightPosition(position); });
+}
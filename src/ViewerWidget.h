@@ -1,52 +1,92 @@
 #pragma once
 #include <QtWidgets>
-#include "Model.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <chrono>
+#include "Renderer.h"
+#include "QualityGovernor.h"
+#include "FrameScheduler.h"
 
 
 class ViewerWidget :public QWidget {
 	Q_OBJECT
 private:
 	QSize areaSize = QSize(0, 0);
-	QImage* img = nullptr;
-	QPainter* painter = nullptr;
-	uchar* data = nullptr;
+	QImage* img = nullptr;          //front buffer, shown by paintEvent
 
 	bool drawLineActivated = false;
 	QPoint drawLineBegin = QPoint(0, 0);
 
-
-	Model model;
-	Camera camera;
-
-	bool drawFilledPolygons = true;
+	//render thread: GUI edits are queued, applied before the next frame, and cancel the frame in flight
+	//frames are drawn into backImg, a finished one is swapped with img
+	Renderer renderer;
+	QImage* backImg = nullptr;
+	std::mutex mutex;                   //edits, flags, img / backImg swap
+	std::condition_variable wake, idle;
+	std::vector<std::function<void(Renderer&)>> edits;
+	bool frameRequested = false;
+	bool rendering = false;
+	bool paused = false;
+	bool quit = false;
+
+	//interactive frames follow the governor's level, the full quality one comes after the input idles
+	QualityGovernor governor;
+	std::chrono::steady_clock::time_point lastInput;
+	bool previewShown = false;
+	QImage previewImg;                  //reduced resolution target, worker only
+
+	//mouse navigation, merged to one edit per display refresh
+	FrameScheduler scheduler;
+	static constexpr float orbitDegreesPerPixel = 0.4f;
+
+	std::thread worker;
+
+	void renderLoop();
+	void applyNavigation(const NavigationInput& input);
 public:
 	ViewerWidget(QSize imgSize, QWidget* parent = Q_NULLPTR);
 	~ViewerWidget();
 	void resizeWidget(QSize size);
 
-
-
-	//
-	void showModel();
+	//queues a renderer edit, the stale frame is abandoned; requestFrame = false only records it
+	void post(std::function<void(Renderer&)> edit, bool requestFrame = true);
+	//worker idle and held, the GUI thread may use the renderer directly until resumeRendering()
+	void pauseRendering();
+	void resumeRendering();
+
+	//drag distances in widget pixels, zoom per wheel step; applied on the next display refresh
+	void orbitBy(QPointF pixels);
+	void panBy(QPointF pixels);
+	void zoomBy(float factor);
+	void setCullBackFaces(bool enabled);
+	void setDepthTest(bool enabled);
+	void setParallelRaster(bool enabled);
+	void setSimdRaster(bool enabled);
+	void setTileCacheBudget(qint64 bytes);
+	void setFrameBudget(double ms);
+	void setShowHud(bool enabled);
+	//Chrome trace of the last frames, callable while rendering
+	bool exportTrace(const QString& path);
 	void showPoints();
-	QVector<QPointF> clipPolygonToRect(const QVector<QPointF>& poly, float xmin, float xmax, float ymin, float ymax);
 
 	//Image functions
 	bool setImage(QFile& inputImg);
-	QImage* getImage() { return img; };
+	QImage grabFrame();     //copy of the shown frame
 	bool isEmpty();
 	bool changeSize(int width, int height);
 
 	void setPixel(int x, int y, uchar r, uchar g, uchar b, uchar a = 255);
 	void setPixel(int x, int y, double valR, double valG, double valB, double valA = 1.);
 	void setPixel(int x, int y, const QColor& color);
-	bool isInside(int x, int y) { return (x >= 0 && y >= 0 && x < img->width() && y < img->height()) ? true : false; }
+	bool isInside(int x, int y) { return Renderer::isInside(*img, x, y); }
 
-	//Draw functions
+	//Draw functions, into the shown frame
 	void drawLine(QPoint start, QPoint end, QColor color);
 
 	void drawCameraAxes(Camera& camera, int screenWidth, int screenHeight, float scale);
-	void drawColorBar(const ColorMap& colormap);
 
 	void setDrawLineBegin(QPoint begin) { drawLineBegin = begin; }
 	QPoint getDrawLineBegin() { return drawLineBegin; }
@@ -55,35 +95,25 @@ public:
 
 	void drawPoly(QVector<QPoint> points, QColor color);
 	//Get/Set functions
-	uchar* getData() { return data; }
-	void setDataPtr() { data = img->bits(); }
-	void setPainter() { painter = new QPainter(img); }
-
 	int getImgWidth() { return img->width(); };
 	int getImgHeight() { return img->height(); };
 
-	Model& getModel() { return model; }
-
-
-	void fillPolygonScanLine(const QVector<QPointF>& polygon, const QColor& color);
-
-	QVector3D transformModelPoint(const QVector3D& p);
-
-
 	void clear();
 
+signals:
+	//after an orbit, from the render thread
+	void rotationChanged(QVector3D rotation);
+
 public slots:
 	void paintEvent(QPaintEvent* event) Q_DECL_OVERRIDE;
 
 	void setModelRotationX(double angle);
 	void setModelRotationY(double angle);
 	void setModelRotationZ(double angle);
+	void setLodTolerance(double pixels);
+	void setRenderMode(int mode);
+	void setColorRamp(int index);
+	void setSmoothShading(bool enabled);
+	void setZScaleFactor(double factor);
+	void setLightPosition(const QVector3D& position);
 };
-
-
-
-struct EdgeEntry {
-	float x;        //
-	float dx;       //1/m
-	int dy;         //
-};
\ No newline at end of file
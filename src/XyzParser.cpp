@@ -0,0 +1,374 @@
+#include "XyzParser.h"
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QDebug>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+struct XyzChunk {
+	const char* begin;
+	const char* end;
+	qint64 maxPoints = 0;   //lines in chunk, upper bound
+	qint64 offset = 0;      //first slot in output
+	qint64 points = 0;
+	QVector<std::pair<const char*, const char*>> badLines;
+};
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool toDouble(const char* begin, const char* end, double& value)
+{
+	if (begin < end && *begin == '+')
+		++begin;
+	auto result = std::from_chars(begin, end, value);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+static qint64 countLines(const char* begin, const char* end)
+{
+	qint64 lines = 0;
+	const char* p = begin;
+	while (p < end) {
+		const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		++lines;
+		if (nl == nullptr) break;
+		p = nl + 1;
+	}
+	return lines;
+}
+
+static void parseChunk(XyzChunk& chunk, Point* out)
+{
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		const char* nl = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+		const char* lineEnd = nl ? nl : chunk.end;
+
+		//trimmed()
+		const char* b = p;
+		const char* e = lineEnd;
+		while (b < e && isSpace(*b)) ++b;
+		while (e > b && isSpace(e[-1])) --e;
+		p = lineEnd + 1;
+		if (b == e) continue;
+
+		//split on whitespace, 3 fields expected
+		const char* tokBegin[3];
+		const char* tokEnd[3];
+		int tokens = 0;
+		const char* t = b;
+		while (t < e) {
+			if (tokens == 3) { tokens++; break; }
+			tokBegin[tokens] = t;
+			while (t < e && !isSpace(*t)) ++t;
+			tokEnd[tokens++] = t;
+			while (t < e && isSpace(*t)) ++t;
+		}
+		if (tokens != 3) {
+			chunk.badLines.append(std::make_pair(b, e));
+			continue;
+		}
+
+		double x, y, z;
+		if (toDouble(tokBegin[0], tokEnd[0], x) && toDouble(tokBegin[1], tokEnd[1], y) && toDouble(tokBegin[2], tokEnd[2], z))
+			out[chunk.points++] = Point(x, y, z);
+	}
+}
+
+//newline aligned chunks of data parsed in parallel into out, bad lines reported and counted
+static qint64 parseBlock(const char* data, qint64 size, QVector<Point>& out)
+{
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	const qint64 minChunkBytes = 1 << 16;
+	int chunkCount = int(std::max<qint64>(1, std::min<qint64>(qint64(threads) * 4, size / minChunkBytes)));
+
+	//newline aligned chunk boundaries
+	QVector<XyzChunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* prev = data;
+	for (int i = 0; i < chunkCount; ++i) {
+		const char* split = end;
+		if (i + 1 < chunkCount) {
+			split = data + size * (i + 1) / chunkCount;
+			if (split < prev) split = prev;
+			const char* nl = static_cast<const char*>(std::memchr(split, '\n', end - split));
+			split = nl ? nl + 1 : end;
+		}
+		chunks[i].begin = prev;
+		chunks[i].end = split;
+		prev = split;
+	}
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < chunkCount; ++i)
+		chunks[i].maxPoints = countLines(chunks[i].begin, chunks[i].end);
+
+	qint64 total = 0;
+	for (XyzChunk& c : chunks) {
+		c.offset = total;
+		total += c.maxPoints;
+	}
+
+	out.clear();
+	out.resize(total);
+	Point* dst = out.data();
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < chunkCount; ++i)
+		parseChunk(chunks[i], dst + chunks[i].offset);
+
+	//close the gaps left by empty/bad lines
+	qint64 written = 0;
+	qint64 badLines = 0;
+	for (const XyzChunk& c : chunks) {
+		if (c.offset != written && c.points > 0)
+			std::memmove(static_cast<void*>(dst + written), dst + c.offset, c.points * sizeof(Point));
+		written += c.points;
+		for (const auto& line : c.badLines)
+			qWarning() << "Bad line" << QString::fromLatin1(line.first, line.second - line.first);
+		badLines += c.badLines.size();
+	}
+	out.resize(written);
+	return badLines;
+}
+
+bool XyzParser::parse(QFile& file, QVector<Point>& out, XyzParseStats* stats)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	qint64 size = file.size();
+	QByteArray fallback;
+	uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+	const char* data = reinterpret_cast<const char*>(mapped);
+	if (data == nullptr) {
+		fallback = file.readAll();
+		data = fallback.constData();
+		size = fallback.size();
+	}
+
+	qint64 badLines = parseBlock(data, size, out);
+
+	if (mapped != nullptr)
+		file.unmap(mapped);
+
+	if (stats != nullptr) {
+		stats->bytes = size;
+		stats->points = out.size();
+		stats->badLines = badLines;
+		stats->ms = timer.nsecsElapsed() / 1e6;
+	}
+	return true;
+}
+
+//row-major grid check of buildGrid, done point by point while the heights go straight to the cache
+class GridStream {
+public:
+	explicit GridStream(QIODevice& out) : out(out) {}
+
+	bool add(const Point* points, qint64 count)
+	{
+		for (qint64 i = 0; i < count; ++i) {
+			const Point& p = points[i];
+			//the first row gives cols and spacingX, the first point of the second row spacingY
+			if (grid.cols == 0) {
+				if (firstRow.isEmpty() || std::abs(p.y - firstRow[0].y) < 1e-9) {
+					firstRow.append(p);
+					continue;
+				}
+				if (!startGrid(p.y))
+					return false;
+			}
+			int col = int(written % grid.cols);
+			int row = int(written / grid.cols);
+			if (std::abs(p.x - grid.xAt(col)) > tolX || std::abs(p.y - grid.yAt(row)) > tolY)
+				return false;
+			if (!append(float(p.z)))
+				return false;
+		}
+		return true;
+	}
+
+	bool finish(qint64 sourceSize)
+	{
+		if (grid.cols == 0 || written % grid.cols != 0 || written / grid.cols < 2)
+			return false;
+		grid.rows = int(written / grid.cols);
+		if (!flush())
+			return false;
+		//the header comes last, rows and the z range are known only now
+		return out.seek(0) && DemCache::writeHeader(out, grid, sourceSize);
+	}
+
+	qint64 points() const { return written; }
+
+private:
+	bool startGrid(double secondRowY)
+	{
+		int cols = firstRow.size();
+		if (cols < 2)
+			return false;
+		grid.originX = firstRow[0].x;
+		grid.originY = firstRow[0].y;
+		grid.spacingX = (firstRow[cols - 1].x - firstRow[0].x) / (cols - 1);
+		grid.spacingY = secondRowY - grid.originY;
+		grid.cols = cols;
+		tolX = 0.1 * std::abs(grid.spacingX);
+		tolY = 0.1 * std::abs(grid.spacingY);
+		if (tolX == 0 || tolY == 0)
+			return false;
+
+		//header space, rewritten by finish()
+		DemCacheHeader header = {};
+		if (out.write(reinterpret_cast<const char*>(&header), sizeof(header)) != qint64(sizeof(header)))
+			return false;
+		for (int c = 0; c < cols; ++c) {
+			if (std::abs(firstRow[c].x - grid.xAt(c)) > tolX || !append(float(firstRow[c].z)))
+				return false;
+		}
+		firstRow = QVector<Point>();
+		return true;
+	}
+
+	bool append(float z)
+	{
+		if (written == 0)
+			grid.minZ = grid.maxZ = z;
+		grid.minZ = std::min(grid.minZ, z);
+		grid.maxZ = std::max(grid.maxZ, z);
+		buffer.append(z);
+		written++;
+		return buffer.size() < bufferSize || flush();
+	}
+
+	bool flush()
+	{
+		qint64 bytes = buffer.size() * qint64(sizeof(float));
+		bool ok = out.write(reinterpret_cast<const char*>(buffer.constData()), bytes) == bytes;
+		buffer.clear();
+		return ok;
+	}
+
+	static const int bufferSize = 1 << 16;
+	QIODevice& out;
+	GridInfo grid;
+	double tolX = 0, tolY = 0;
+	QVector<Point> firstRow;
+	QVector<float> buffer;
+	qint64 written = 0;
+};
+
+bool XyzParser::parseToCache(QFile& file, const QString& cachePath, qint64 sourceSize, QVector<Point>& points, XyzParseStats* stats)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	points.clear();
+	qint64 size = file.size();
+	uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+	if (mapped == nullptr)
+		return false;
+	const char* data = reinterpret_cast<const char*>(mapped);
+
+	//newline aligned windows, only one window of points is held at a time while the grid check holds;
+	//after it fails (or without a cache to write) every point is kept in points, the file is still parsed once
+	QSaveFile out(cachePath);
+	bool streaming = out.open(QIODevice::WriteOnly);
+	GridStream grid(out);
+	QVector<Point> window;
+	qint64 badLines = 0;
+	const char* end = data + size;
+	for (const char* begin = data; begin < end;) {
+		const char* split = end;
+		if (end - begin > streamWindowBytes) {
+			const char* nl = static_cast<const char*>(std::memchr(begin + streamWindowBytes, '\n', end - begin - streamWindowBytes));
+			split = nl ? nl + 1 : end;
+		}
+		badLines += parseBlock(begin, split - begin, window);
+		if (streaming && !grid.add(window.constData(), window.size())) {
+			//off the grid, usually in the first window; earlier windows are parsed again
+			streaming = false;
+			if (begin > data)
+				parseBlock(data, begin - data, points);
+		}
+		if (!streaming)
+			points += window;
+		begin = split;
+	}
+
+	bool cached = streaming && grid.finish(sourceSize);
+	if (streaming && !cached)
+		parseBlock(data, size, points);
+	file.unmap(mapped);
+
+	if (cached && !out.commit()) {
+		qWarning() << "Cannot write cache" << cachePath;
+		cached = false;
+	}
+	if (!cached)
+		out.cancelWriting();
+
+	if (stats != nullptr) {
+		stats->bytes = size;
+		stats->points = cached ? grid.points() : points.size();
+		stats->badLines = badLines;
+		stats->ms = timer.nsecsElapsed() / 1e6;
+	}
+	return cached;
+}
+
+bool XyzParser::parseTextStream(QFile& file, QVector<Point>& out, XyzParseStats* stats)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	qint64 badLines = 0;
+	QTextStream in(&file);
+
+	while (!in.atEnd()) {
+		QString line = in.readLine().trimmed();
+		if (line.isEmpty()) continue;
+
+		QStringList parts = line.split(QRegularExpression("\\s+"));
+		if (parts.size() != 3) {
+			qWarning() << "Bad line" << line;
+			badLines++;
+			continue;
+		}
+
+		bool ok1, ok2, ok3;
+		double x = parts[0].toDouble(&ok1);
+		double y = parts[1].toDouble(&ok2);
+		double z = parts[2].toDouble(&ok3);
+
+		if (ok1 && ok2 && ok3) {
+			Point point{ x,y,z };
+			out.append(point);
+		}
+	}
+
+	if (stats != nullptr) {
+		stats->bytes = file.size();
+		stats->points = out.size();
+		stats->badLines = badLines;
+		stats->ms = timer.nsecsElapsed() / 1e6;
+	}
+	return true;
+}
+
+void XyzParser::printStats(const char* label, const XyzParseStats& stats)
+{
+	qDebug() << label << stats.points << "points," << stats.badLines << "bad lines,"
+		<< stats.bytes / (1024.0 * 1024.0) << "MB in" << stats.ms << "ms ->" << stats.mbPerSec() << "MB/s";
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <QFile>
+#include <QVector>
+#include "Model.h"
+
+struct XyzParseStats {
+	qint64 bytes = 0;
+	qint64 points = 0;
+	qint64 badLines = 0;
+	double ms = 0;
+	double mbPerSec() const { return ms > 0 ? (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0; }
+};
+
+//ASCII "x y z" per line loader
+class XyzParser {
+public:
+	//mapped file, newline aligned chunks parsed in parallel with std::from_chars
+	static bool parse(QFile& file, QVector<Point>& out, XyzParseStats* stats = nullptr);
+	//row-major grid parsed window by window straight into a .demc cache, the points are never all in memory;
+	//false (nothing written) when the points are not a complete regular grid or the cache cannot be written,
+	//points then holds the parsed input for buildGrid / buildScattered
+	static bool parseToCache(QFile& file, const QString& cachePath, qint64 sourceSize, QVector<Point>& points, XyzParseStats* stats = nullptr);
+	static const qint64 streamWindowBytes = qint64(32) << 20;
+	//old QTextStream + QRegularExpression path, kept for comparison
+	static bool parseTextStream(QFile& file, QVector<Point>& out, XyzParseStats* stats = nullptr);
+
+	static void printStats(const char* label, const XyzParseStats& stats);
+};